@@ -2,139 +2,277 @@
 
 #include "BusAddr.h"
 #include "BusCommand.h"
+#include "BusCommandList.h"
+#include "BusConfig.h"
+#include "BusLatest.h"
+#include "BusMailbox.h"
+#include "BusMsg.h"
+#include "BusMutex.h"
+#include "BusRpc.h"
+#include "BusStats.h"
+#include "BusTimer.h"
+#include "BusTopic.h"
+#include "BusTopicList.h"
 
 #include <stdint.h>
-#include <list>
+#include <array>
+#include <atomic>
 #include <string>
 #include <memory>
+#include <type_traits>
 
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
-
-namespace bus {
-
-#define USE_FREE_RTOS_MUTEX 1
-#ifdef USE_FREE_RTOS_MUTEX
 #include "freertos/semphr.h"
+#include "freertos/task.h"
 
-class FreeRtosMutex {
-public:
-    FreeRtosMutex()
-    : m_semaphore( xSemaphoreCreateMutex() ) {}
+namespace bus {
 
-    ~FreeRtosMutex() {
-        vSemaphoreDelete( m_semaphore );
-        m_semaphore = nullptr;
-    }
+/**
+ * @brief What a send does when the lane of a destination is full
+ */
+struct DeliveryPolicy {
+    enum class Mode : uint8_t {
+        DropNewest,  // the full destinations miss the new message
+        DropOldest,  // the oldest message of the full lane is dropped to make room
+        FailFast,    // nothing is delivered when any destination is full
+        Block        // wait up to timeout ticks for a receiver to make room, without holding the bus mutex
+    };
 
-    FreeRtosMutex( const FreeRtosMutex& other ) = delete;
-    FreeRtosMutex( const FreeRtosMutex&& other ) = delete;
-    FreeRtosMutex& operator=( const FreeRtosMutex& other ) = delete;
+    Mode mode = Mode::DropNewest;
+    TickType_t timeout = 0;
+    bool isSenderExcluded = false;  // a group send skips the sender when it is a member
 
-    inline bool lock() {
-        return ( pdPASS == xSemaphoreTake( m_semaphore, portMAX_DELAY ) );
+    /**
+     * @brief Same policy, the sender doesn't receive its own group message, e.g. a bridge injecting remote commands
+     */
+    constexpr DeliveryPolicy excludingSender() const {
+        return DeliveryPolicy{ mode, timeout, true };
     }
 
-    inline bool release() {
-        return ( pdPASS == xSemaphoreGive( m_semaphore ) );
+    static constexpr DeliveryPolicy dropNewest() {
+        return DeliveryPolicy{ Mode::DropNewest, 0 };
     }
 
-private:
-    SemaphoreHandle_t m_semaphore;
-};
-
-class FreeRtosMutexLock {
-public:
-    explicit FreeRtosMutexLock( FreeRtosMutex& lock )
-    : m_lock( lock ) {
-        m_isLocked = m_lock.lock();
+    static constexpr DeliveryPolicy dropOldest() {
+        return DeliveryPolicy{ Mode::DropOldest, 0 };
     }
 
-    ~FreeRtosMutexLock() {
-        release();
+    static constexpr DeliveryPolicy failFast() {
+        return DeliveryPolicy{ Mode::FailFast, 0 };
     }
 
-    FreeRtosMutexLock( const FreeRtosMutexLock& other ) = delete;
-    FreeRtosMutexLock( const FreeRtosMutexLock&& other ) = delete;
-    FreeRtosMutexLock& operator=( const FreeRtosMutexLock& other ) = delete;
-
-    inline bool isLocked() const {
-        return m_isLocked;
+    static constexpr DeliveryPolicy block( TickType_t timeout ) {
+        return DeliveryPolicy{ Mode::Block, timeout };
     }
-
-    inline bool release() {
-        if( m_isLocked ) {
-            m_isLocked = !m_lock.release();
-        }
-
-        return !m_isLocked;
-    }
-
-private:
-    FreeRtosMutex &m_lock;
-    bool m_isLocked = false;
 };
 
-using MutexType = FreeRtosMutex;
-using LockGuardType = FreeRtosMutexLock;
-
-#else
-#include <mutex>
-using MutexType = std::mutex;
-#endif
+enum class SendResult : uint8_t {
+    Delivered,   // every destination got the message
+    Dropped,     // at least one destination was full or left during a blocking send, see DeliveryPolicy
+    Unresolved,  // invalid address or command, no connected client or an empty group
+    NoMemory     // the message pool is exhausted
+};
 
-struct BusMsg;
 class IBusClient;
 
 class Bus {
     friend class IBusClient; // use Bus mutex
 public:
+    static constexpr std::size_t MAX_CLIENTS = BUS_MAX_CLIENTS;
+    static constexpr std::size_t MAX_GROUPS = BUS_MAX_GROUPS;
+    static constexpr std::size_t MAX_GROUP_MEMBERS = BUS_MAX_GROUP_MEMBERS;
+
+    Bus();
+    ~Bus();
+
+    Bus( const Bus& other ) = delete;
+    Bus& operator=( const Bus& other ) = delete;
+
     bool connect( IBusClient& client );
     void disconnect( IBusClient& client );
 
+    /**
+     * @brief Join a group by its topic, the group is created on the first join
+     *
+     * Names are hashed into TopicId, two names with the same hash share a group.
+     */
+    bool join( TopicId topic, IBusClient& client );
+    void leave( TopicId topic, IBusClient& client );
+
     bool join( const char* addrName, IBusClient& client );
     void leave( const char* addrName, IBusClient& client );
 
-    std::list<BusAddr> destination( BusAddr addr );
-    QueueHandle_t resolve( BusAddr addr );
+    /**
+     * @brief Make a named group a latest-value topic, the group is created when missing
+     *
+     * A member keeps only the newest undelivered message of every key sent to the
+     * topic (see IBusClient::publish), an older one is replaced in place.
+     * @return topic address or BusAddrInvalid if no group is left
+     */
+    BusAddr coalesce( TopicId topic );
+    BusAddr coalesce( const char* addrName );
+
+    Mailbox* resolve( BusAddr addr );
+    BusAddr resolve( TopicId topic );
     BusAddr resolve( const char* addrName );
 
+    BusMsgPool::Stats poolStats() {
+        return m_pool.stats();
+    }
+
+    /**
+     * @brief Fire the due timers of IBusClient::sendAt() and IBusClient::sendEvery()
+     *
+     * Sleeps until the nearest deadline, a new timer or for at most waitTime
+     * ticks. Only one task services the timers of a bus, see timerTask().
+     * Firings are delivered with DeliveryPolicy::dropNewest(), a full
+     * receiver never stalls the other timers.
+     */
+    void serviceTimers( TickType_t waitTime );
+
+    /**
+     * @brief FreeRTOS task function servicing the timers of the Bus passed as the parameter
+     */
+    static void timerTask( void* bus );
+
+    TimerWheel::Stats timerStats() {
+        return m_timers.stats();
+    }
+
+#if BUS_ENABLE_STATS
+    BusStats stats();
+
+    /**
+     * @brief Counters of a connected client, zeros for any other address
+     */
+    ClientStats clientStats( BusAddr addr );
+
+    /**
+     * @brief Counters of a group, zeros for any other address
+     */
+    TrafficCounters groupStats( BusAddr addr );
+
+    void resetStats();
+#endif
+
 protected:
     bool join( BusAddr addr, IBusClient& client );
     void leave( BusAddr addr, IBusClient& client );
 
+private:
+    /**
+     * Client addresses are -(slot + 1 + n * MAX_CLIENTS), where n is bumped every time
+     * the slot is reused. The slot is recovered from the address without a search and
+     * a stale address of a reconnected slot never resolves to the new client.
+     */
+    static std::size_t clientSlot( BusAddr addr ) {
+        return static_cast<std::size_t>( -( addr + 1 ) ) % MAX_CLIENTS;
+    }
+
+    /**
+     * Group addresses are allocated sequentially starting from 1 and never released.
+     */
+    static std::size_t groupSlot( BusAddr addr ) {
+        return static_cast<std::size_t>( addr - 1 );
+    }
+
+    static bool isGroupAddr( BusAddr addr ) {
+        return addr > BusAddrInvalid && static_cast<std::size_t>( addr ) <= MAX_GROUPS;
+    }
+
+    BusAddr nextClientAddr( std::size_t slot ) const;
+    BusAddr findGroup( TopicId topic, bool isCreated );
+    void leaveAll( BusAddr clientAddr );
+
+    enum class Delivery : uint8_t { Delivered, DroppedFull, DroppedUnresolved };
+
+    struct Client;
+    Client* findClient( BusAddr addr );
+
+    SendResult deliver( BusMsgPtr busMsg, DeliveryPolicy policy );
+    Delivery enqueue( BusMsg& busMsg, BusAddr destination, DeliveryPolicy::Mode mode );
+    Delivery enqueueLatest( Client& client, LatestSlot& slot, BusMsg& busMsg );
+    void dropFull( const BusMsg& busMsg, const BusAddr* full, std::size_t fullCount );
+
+    template <typename Cmd>
+    TimerId schedule( BusAddr from, BusAddr to, Cmd&& cmd, Priority priority, TickType_t deadline, TickType_t period ) {
+        const auto timer = m_timers.schedule( from, to, std::forward<Cmd>( cmd ), priority, xTaskGetTickCount(), deadline, period );
+        if( TimerIdInvalid != timer ) {
+            wakeTimerTask();  // the new deadline may come before the one the task sleeps for
+        }
+        return timer;
+    }
+
+    void wakeTimerTask();
+
+    /**
+     * @brief Wake the senders blocked for room, called by a receiver that took messages
+     */
+    void signalSpace();
+
+#if BUS_ENABLE_STATS
+    static void count( TrafficCounters& counters, Delivery delivery );
+    void count( const BusMsg& busMsg, BusAddr destination, Delivery delivery );
+    void countSent( const BusMsg& busMsg, bool isResolved );
+    void countUnresolved( const BusMsg& busMsg );
+#endif
+
 private:
     MutexType m_mutex;
-    BusAddr m_addrLast = BusAddrInvalid;
+    BusMsgPool m_pool;
+    TimerWheel m_timers;
+    std::atomic<TaskHandle_t> m_timerTask{ nullptr };
+    SemaphoreHandle_t m_space = nullptr;  // given by the receivers while senders block
+    std::atomic<uint32_t> m_blockedSenders{ 0 };
     BusAddr m_groupLast = BusAddrInvalid;
 
     struct Client {
-        BusAddr addr;
-        QueueHandle_t queue;
-
-        Client( BusAddr _addr, QueueHandle_t _queue )
-        : addr( _addr )
-        , queue( _queue ) {}
+        BusAddr addr = BusAddrInvalid;  // last address issued for the slot
+        Mailbox* mailbox = nullptr;     // nullptr - slot is free
+        LatestTable* latest = nullptr;
+#if BUS_ENABLE_STATS
+        ClientStats stats;
+#endif
     };
-    std::list<Client> m_clients;
+    std::array<Client, MAX_CLIENTS> m_clients;
 
     struct Group {
-        BusAddr addr;
-        std::string addrName;
-        std::list<BusAddr> destination;
-
-        Group( BusAddr _addr, const char* _addrName = nullptr )
-        : addr( _addr )
-        , addrName( _addrName ) {}
+        BusAddr addr = BusAddrInvalid;  // BusAddrInvalid - slot is free
+        TopicId topic;  // invalid for an anonymous group
+        std::array<BusAddr, MAX_GROUP_MEMBERS> destination;
+        std::size_t destinationCount = 0;
+        bool isLatest = false;  // latest-value topic
+#if BUS_ENABLE_STATS
+        TrafficCounters stats;
+#endif
     };
-    std::list<Group> m_groups;
+    std::array<Group, MAX_GROUPS> m_groups;
+
+    /**
+     * Open addressing index of the named groups, a cell holds the group slot + 1.
+     * Groups are never released, so the index needs no tombstones.
+     */
+    static constexpr std::size_t TOPIC_INDEX_SIZE = []() {
+        std::size_t size = 2;
+        while( size < 2 * MAX_GROUPS ) {
+            size *= 2;
+        }
+        return size;
+    }();
+    std::array<uint16_t, TOPIC_INDEX_SIZE> m_topicIndex{};
+    static_assert( MAX_GROUPS < UINT16_MAX, "Too many groups for the topic index" );
+
+#if BUS_ENABLE_STATS
+    TrafficCounters m_total;        // guarded by m_mutex
+    LatencyHistogram m_latency;     // updated by the receivers without the mutex
+#endif
 };
 
 class IBusClient {
     friend class Bus;
 
 public:
-    static constexpr int MESSAGE_QUEUE_LENGTH = 32;
+    static constexpr int MESSAGE_QUEUE_LENGTH = Mailbox::LENGTH;  // per priority lane
 
     IBusClient(Bus &bus)
     : m_bus(bus) {}
@@ -144,25 +282,203 @@ public:
     bool initialize();
     bool isConnectedToBus();
 
-    void send( BusAddr to, std::unique_ptr<IBusCommand> msg ) const;
-    void send( const char* to, std::unique_ptr<IBusCommand> msg ) const;
+    SendResult send( BusAddr to, std::unique_ptr<IBusCommand> msg, Priority priority = Priority::Normal, DeliveryPolicy policy = DeliveryPolicy() ) const;
+    SendResult send( TopicId to, std::unique_ptr<IBusCommand> msg, Priority priority = Priority::Normal, DeliveryPolicy policy = DeliveryPolicy() ) const;
+    SendResult send( const char* to, std::unique_ptr<IBusCommand> msg, Priority priority = Priority::Normal, DeliveryPolicy policy = DeliveryPolicy() ) const;
+
+    /**
+     * @brief Send a command constructed in place inside a pooled message
+     *
+     * No heap allocation takes place, the command type must fit into CommandStorage::INLINE_SIZE.
+     */
+    template <typename Cmd, typename std::enable_if<std::is_base_of<IBusCommand, typename std::decay<Cmd>::type>::value, int>::type = 0>
+    SendResult send( BusAddr to, Cmd&& cmd, Priority priority = Priority::Normal, DeliveryPolicy policy = DeliveryPolicy() ) const {
+        if( to == BusAddrInvalid ) {
+            return SendResult::Unresolved;
+        }
+        auto busMsg = compose( to, std::forward<Cmd>( cmd ), priority );
+        if( !busMsg ) {
+            return SendResult::NoMemory;
+        }
+        return m_bus.deliver( std::move( busMsg ), policy );
+    }
+
+    template <typename Cmd, typename std::enable_if<std::is_base_of<IBusCommand, typename std::decay<Cmd>::type>::value, int>::type = 0>
+    SendResult send( TopicId to, Cmd&& cmd, Priority priority = Priority::Normal, DeliveryPolicy policy = DeliveryPolicy() ) const {
+        return send( m_bus.resolve( to ), std::forward<Cmd>( cmd ), priority, policy );
+    }
+
+    /**
+     * @brief Send to a named group, the name is hashed on every call, prefer TopicId constants
+     */
+    template <typename Cmd, typename std::enable_if<std::is_base_of<IBusCommand, typename std::decay<Cmd>::type>::value, int>::type = 0>
+    SendResult send( const char* to, Cmd&& cmd, Priority priority = Priority::Normal, DeliveryPolicy policy = DeliveryPolicy() ) const {
+        if( !to ) {
+            return SendResult::Unresolved;
+        }
+        return send( TopicId::hash( to ), std::forward<Cmd>( cmd ), priority, policy );
+    }
+
+    /**
+     * @brief Send a keyed command to a latest-value topic, see Bus::coalesce()
+     *
+     * An undelivered message with the same key is replaced in the mailbox of every member.
+     */
+    template <typename Cmd, typename std::enable_if<std::is_base_of<IBusCommand, typename std::decay<Cmd>::type>::value, int>::type = 0>
+    SendResult publish( BusAddr topic, uint64_t key, Cmd&& cmd, Priority priority = Priority::Normal ) const {
+        if( topic == BusAddrInvalid ) {
+            return SendResult::Unresolved;
+        }
+        auto busMsg = compose( topic, std::forward<Cmd>( cmd ), priority );
+        if( !busMsg ) {
+            return SendResult::NoMemory;
+        }
+        busMsg->key = key;
+        return m_bus.deliver( std::move( busMsg ), DeliveryPolicy() );
+    }
+
+    /**
+     * @brief Send a request, the callback gets the response or the timeout from drain()
+     *
+     * Must run on the task receiving for this client. The call occupies one of
+     * PendingCalls::SIZE slots until it completes, no heap allocation takes place.
+     * The callback is not invoked if the request could not be delivered.
+     */
+    template <typename Cmd, typename std::enable_if<std::is_base_of<IBusCommand, typename std::decay<Cmd>::type>::value, int>::type = 0>
+    SendResult call( BusAddr to, Cmd&& cmd, RpcCallback callback, void* context, TickType_t timeout, Priority priority = Priority::Normal ) {
+        if( to == BusAddrInvalid ) {
+            return SendResult::Unresolved;
+        }
+        const uint32_t correlation = m_calls.open( callback, context, timeout );
+        auto busMsg = correlation ? compose( to, std::forward<Cmd>( cmd ), priority ) : nullptr;
+        if( !busMsg ) {
+            m_calls.discard( correlation );
+            return SendResult::NoMemory;
+        }
+        busMsg->correlation = correlation;
+        const auto result = m_bus.deliver( std::move( busMsg ), DeliveryPolicy() );
+        if( SendResult::Delivered != result ) {
+            m_calls.discard( correlation );
+        }
+        return result;
+    }
+
+    /**
+     * @brief Complete every outstanding call() with RpcResult::Cancelled
+     *
+     * Runs from ~IBusClient() too, but by then a derived client is already
+     * destroyed; a client passing itself as the callback context cancels
+     * from its own destructor.
+     */
+    void cancelCalls() {
+        m_calls.cancelAll();
+    }
+
+    /**
+     * @brief Answer a request, see request()
+     */
+    template <typename Cmd, typename std::enable_if<std::is_base_of<IBusCommand, typename std::decay<Cmd>::type>::value, int>::type = 0>
+    SendResult reply( const RpcRequest& request, Cmd&& cmd, Priority priority = Priority::Normal ) const {
+        if( !request.isValid() ) {
+            return SendResult::Unresolved;
+        }
+        auto busMsg = compose( request.from, std::forward<Cmd>( cmd ), priority );
+        if( !busMsg ) {
+            return SendResult::NoMemory;
+        }
+        busMsg->correlation = request.correlation;
+        busMsg->isResponse = true;
+        return m_bus.deliver( std::move( busMsg ), DeliveryPolicy() );
+    }
+
+    /**
+     * @brief Send a copy of the command at the deadline tick, see Bus::serviceTimers()
+     *
+     * The timer keeps the command until it fires, the command type must be copy
+     * constructible and fit into CommandStorage::INLINE_SIZE. A passed deadline
+     * fires on the next timer tick.
+     * @return TimerIdInvalid for an invalid address or if every timer is taken
+     */
+    template <typename Cmd, typename std::enable_if<std::is_base_of<IBusCommand, typename std::decay<Cmd>::type>::value, int>::type = 0>
+    TimerId sendAt( BusAddr to, Cmd&& cmd, TickType_t deadline, Priority priority = Priority::Normal ) const {
+        if( to == BusAddrInvalid ) {
+            return TimerIdInvalid;
+        }
+        return m_bus.schedule( m_addr, to, std::forward<Cmd>( cmd ), priority, deadline, 0 );
+    }
+
+    /**
+     * @brief Send a copy of the command every period ticks until cancel(), the first one a period from now
+     */
+    template <typename Cmd, typename std::enable_if<std::is_base_of<IBusCommand, typename std::decay<Cmd>::type>::value, int>::type = 0>
+    TimerId sendEvery( BusAddr to, Cmd&& cmd, TickType_t period, Priority priority = Priority::Normal ) const {
+        if( to == BusAddrInvalid || !period ) {
+            return TimerIdInvalid;
+        }
+        return m_bus.schedule( m_addr, to, std::forward<Cmd>( cmd ), priority, xTaskGetTickCount() + period, period );
+    }
+
+    /**
+     * @brief Stop a timer of sendAt() or sendEvery(), false if it is already gone
+     */
+    bool cancel( TimerId timer ) const;
 
     BusAddr addr() const {
         return m_addr;
     }
 
 protected:
+    /**
+     * @brief Receive a single message, waiting up to waitTime ticks for it
+     */
     void tryReceive( TickType_t waitTime );
-    
-    virtual void receive( const BusAddr from, const BusAddr to, const std::unique_ptr<IBusCommand>& msg ) = 0;
 
-private:
-    void sendToNextClient( std::unique_ptr<BusMsg> busMsg ) const;
+    /**
+     * @brief Receive queued messages until the mailbox is empty or maxMessages were received
+     *
+     * Only the first message is waited for (up to waitTime ticks), the rest of
+     * the batch is taken without blocking. The wait ends early at the deadline
+     * of an outstanding call().
+     * @return number of received messages
+     */
+    std::size_t drain( std::size_t maxMessages, TickType_t waitTime );
+
+    /**
+     * @brief Request being received, invalid outside of receive() or for a plain message
+     *
+     * A copy of it may be kept to reply later.
+     */
+    const RpcRequest& request() const {
+        return m_request;
+    }
+
+    virtual void receive( const BusAddr from, const BusAddr to, const IBusCommand& msg ) = 0;
+
+    /**
+     * @brief Receive a command listed in command::Variant, forwards to the type erased receive() by default
+     */
+    virtual void receive( const BusAddr from, const BusAddr to, const command::Variant& msg ) {
+        std::visit( [this, from, to]( const auto& cmd ) { receive( from, to, static_cast<const IBusCommand&>( cmd ) ); }, msg );
+    }
 
 private:
+    template <typename Cmd>
+    BusMsgPtr compose( BusAddr to, Cmd&& cmd, Priority priority ) const {
+        auto busMsg = m_bus.m_pool.acquire( m_addr, to, priority );
+        if( busMsg ) {
+            busMsg->command.emplace<typename std::decay<Cmd>::type>( std::forward<Cmd>( cmd ) );
+        }
+        return busMsg;
+    }
+
+    void dispatch( BusMsgPtr busMsg );
+
     Bus &m_bus;
     BusAddr m_addr = BusAddrInvalid;
-    QueueHandle_t m_queue = nullptr;
+    Mailbox m_mailbox;
+    LatestTable m_latest;
+    PendingCalls m_calls;
+    RpcRequest m_request;
 };
 
 struct EventsHandler {
@@ -172,9 +488,36 @@ struct EventsHandler {
 
 template <typename Visitor>
 class BusMessageHandler : public IBusClient, public Visitor {
+public:
+    explicit BusMessageHandler( Bus& bus )
+    : IBusClient( bus ) {}
+
 protected:
-    void receive( const BusAddr from, const BusAddr to, const std::unique_ptr<IBusCommand>& msg ) override {
-        msg->accept(from, to, *this);
+    void receive( const BusAddr from, const BusAddr to, const IBusCommand& msg ) override {
+        msg.accept(from, to, *this);
+    }
+
+    void receive( const BusAddr from, const BusAddr to, const command::Variant& msg ) override {
+        std::visit( [this, from, to]( const auto& cmd ) { visitStatic( from, to, cmd ); }, msg );
+    }
+
+private:
+    /**
+     * Unqualified call, an override in a class derived from the handler still
+     * wins. Declare the overrides of Visitor final to let the compiler skip the vtable.
+     */
+    template <typename Cmd>
+    auto visitStatic( const BusAddr from, const BusAddr to, const Cmd& cmd )
+        -> decltype( std::declval<Visitor&>().visit( from, to, cmd ), void() ) {
+        static_cast<Visitor&>( *this ).visit( from, to, cmd );
+    }
+
+    /**
+     * Visitor hides the visit() of this command, the virtual one is called as accept() would
+     */
+    template <typename Cmd, typename... Args>
+    void visitStatic( const BusAddr from, const BusAddr to, const Cmd& cmd, Args&&... ) {
+        static_cast<IBusCommandVisitor&>( *this ).visit( from, to, cmd );
     }
 };
 
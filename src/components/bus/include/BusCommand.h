@@ -14,14 +14,14 @@ struct ExampleCmd2;
 struct IBusCommandVisitor {
     virtual ~IBusCommandVisitor() = default;
 
-    virtual void visit( const BusAddr from, const BusAddr to, command::ExampleCmd1& command ) {}
-    virtual void visit( const BusAddr from, const BusAddr to, command::ExampleCmd2& command ) {}
+    virtual void visit( const BusAddr from, const BusAddr to, const command::ExampleCmd1& command ) {}
+    virtual void visit( const BusAddr from, const BusAddr to, const command::ExampleCmd2& command ) {}
 };
 
 struct IBusCommand {
     virtual ~IBusCommand() = default;
 
-    virtual void accept( const BusAddr from, const BusAddr to, IBusCommandVisitor& client ) = 0;
+    virtual void accept( const BusAddr from, const BusAddr to, IBusCommandVisitor& client ) const = 0;
 };
 
 }  // namespace bus
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "BusCommand.h"
+
+#include <stdint.h>
+#include <type_traits>
+#include <variant>
+
+namespace bus {
+namespace command {
+
+struct ExampleCmd1 : public IBusCommand {
+    int32_t value = 0;
+
+    ExampleCmd1() = default;
+
+    explicit ExampleCmd1( int32_t _value )
+    : value( _value ) {}
+
+    void accept( const BusAddr from, const BusAddr to, IBusCommandVisitor& client ) const override {
+        client.visit( from, to, *this );
+    }
+
+    template <typename Stream>
+    bool write( Stream& stream ) const {
+        return stream.write( value );
+    }
+
+    template <typename Stream>
+    bool read( Stream& stream ) {
+        return stream.read( value );
+    }
+};
+
+struct ExampleCmd2 : public IBusCommand {
+    uint32_t id = 0;
+    float value = 0.f;
+
+    ExampleCmd2() = default;
+
+    ExampleCmd2( uint32_t _id, float _value )
+    : id( _id )
+    , value( _value ) {}
+
+    void accept( const BusAddr from, const BusAddr to, IBusCommandVisitor& client ) const override {
+        client.visit( from, to, *this );
+    }
+
+    template <typename Stream>
+    bool write( Stream& stream ) const {
+        return stream.write( id ) && stream.write( value );
+    }
+
+    template <typename Stream>
+    bool read( Stream& stream ) {
+        return stream.read( id ) && stream.read( value );
+    }
+};
+
+/**
+ * @brief Commands known at compile time
+ *
+ * Listed commands are stored inline in the bus message and dispatched by
+ * BusMessageHandler through the std::visit jump table, without the
+ * accept/visit pair of virtual calls. A new command is added here and
+ * to IBusCommandVisitor. The templated write()/read() of a listed command
+ * serialize it for the streams of the common component (see BusBridge),
+ * the index in the variant identifies the command on the wire, so new
+ * commands are appended.
+ */
+using Variant = std::variant<ExampleCmd1, ExampleCmd2>;
+
+template <typename Cmd, typename List = Variant>
+struct IsListed;
+
+template <typename Cmd, typename... Cmds>
+struct IsListed<Cmd, std::variant<Cmds...>> : std::disjunction<std::is_same<Cmd, Cmds>...> {};
+
+}  // namespace command
+}  // namespace bus
@@ -0,0 +1,85 @@
+#pragma once
+
+/**
+ * @brief Compile time configuration of the bus component
+ *
+ * Every value may be overridden from the build, e.g. -DBUS_MAX_CLIENTS=32
+ */
+
+// 1 - FreeRTOS mutexes, 0 - std::mutex
+#ifndef USE_FREE_RTOS_MUTEX
+#define USE_FREE_RTOS_MUTEX 1
+#endif
+
+// 1 - lock-free ring mailboxes, 0 - FreeRTOS queue mailboxes
+#ifndef USE_LOCK_FREE_MAILBOX
+#define USE_LOCK_FREE_MAILBOX 0
+#endif
+
+#ifndef BUS_MAX_CLIENTS
+#define BUS_MAX_CLIENTS 16
+#endif
+
+#ifndef BUS_MAX_GROUPS
+#define BUS_MAX_GROUPS 16
+#endif
+
+#ifndef BUS_MAX_GROUP_MEMBERS
+#define BUS_MAX_GROUP_MEMBERS 8
+#endif
+
+#ifndef BUS_MESSAGE_POOL_SIZE
+#define BUS_MESSAGE_POOL_SIZE 32
+#endif
+
+#ifndef BUS_COMMAND_INLINE_SIZE
+#define BUS_COMMAND_INLINE_SIZE 16
+#endif
+
+// Length of every mailbox lane, must be a power of two for the lock-free mailbox
+#ifndef BUS_MAILBOX_LENGTH
+#define BUS_MAILBOX_LENGTH 32
+#endif
+
+// Mailbox lane draining: 0 - strict priority, 1 - weighted round robin
+#ifndef BUS_MAILBOX_WEIGHTED_DRAIN
+#define BUS_MAILBOX_WEIGHTED_DRAIN 0
+#endif
+
+// Messages taken from a lane per round of the weighted draining
+#ifndef BUS_LANE_WEIGHT_CONTROL
+#define BUS_LANE_WEIGHT_CONTROL 8
+#endif
+
+#ifndef BUS_LANE_WEIGHT_NORMAL
+#define BUS_LANE_WEIGHT_NORMAL 4
+#endif
+
+#ifndef BUS_LANE_WEIGHT_BULK
+#define BUS_LANE_WEIGHT_BULK 1
+#endif
+
+// Distinct (topic, key) pairs a client keeps from latest-value topics, further keys are queued
+#ifndef BUS_LATEST_SLOTS
+#define BUS_LATEST_SLOTS 8
+#endif
+
+// Outstanding IBusClient::call() requests per client, at most 256
+#ifndef BUS_RPC_SLOTS
+#define BUS_RPC_SLOTS 4
+#endif
+
+// 1 - traffic counters, mailbox high-water marks and latency histogram, 0 - compiled out
+#ifndef BUS_ENABLE_STATS
+#define BUS_ENABLE_STATS 1
+#endif
+
+// Pending IBusClient::sendAt() / sendEvery() timers of a bus
+#ifndef BUS_MAX_TIMERS
+#define BUS_MAX_TIMERS 8
+#endif
+
+// Slots of the timer wheel, one per tick of a revolution, a power of two
+#ifndef BUS_TIMER_WHEEL_SLOTS
+#define BUS_TIMER_WHEEL_SLOTS 64
+#endif
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "BusAddr.h"
+#include "BusConfig.h"
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace bus {
+
+struct BusMsg;
+
+/**
+ * @brief Newest undelivered message of a (topic, key) pair of one receiver
+ */
+struct LatestSlot {
+    BusAddr topic = BusAddrInvalid;  // BusAddrInvalid - slot is free
+    uint64_t key = 0;
+    bool isLeft = false;  // the receiver left the topic, the slot is free once its message was taken
+    std::atomic<BusMsg*> msg{ nullptr };
+};
+
+/**
+ * @brief Latest-value slots of a receiver
+ *
+ * A slot holding a message has exactly one token queued in the mailbox, a
+ * newer message replaces the stored one in place and the token delivers
+ * whatever is stored when it is received. Slots are allocated by the senders
+ * under the bus mutex and stay assigned to their key until the receiver
+ * leaves the topic. A slot still holding a message has a token queued, it
+ * is reused only after the receiver took the message.
+ */
+class LatestTable {
+public:
+    static constexpr std::size_t SIZE = BUS_LATEST_SLOTS;
+
+    LatestTable() = default;
+
+    LatestTable( const LatestTable& other ) = delete;
+    LatestTable& operator=( const LatestTable& other ) = delete;
+
+    /**
+     * @brief Slot of the key, a free one is assigned to it, nullptr if the table is full
+     */
+    LatestSlot* find( BusAddr topic, uint64_t key ) {
+        LatestSlot* free = nullptr;
+        for( auto& slot : m_slots ) {
+            if( slot.topic == topic && slot.key == key ) {
+                slot.isLeft = false;  // joined again before the slot was reused
+                return &slot;
+            }
+            if( !free && isFree( slot ) ) {
+                free = &slot;
+            }
+        }
+        if( free ) {
+            free->topic = topic;
+            free->key = key;
+            free->isLeft = false;
+        }
+        return free;
+    }
+
+    /**
+     * @brief Give back the slots of a topic the receiver left, BusAddrInvalid for every topic
+     */
+    void release( BusAddr topic ) {
+        for( auto& slot : m_slots ) {
+            if( slot.topic != BusAddrInvalid && ( topic == BusAddrInvalid || slot.topic == topic ) ) {
+                slot.isLeft = true;
+                if( isFree( slot ) ) {
+                    slot.topic = BusAddrInvalid;
+                    slot.isLeft = false;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Mailbox entry standing for the message stored in the slot
+     */
+    static BusMsg* token( LatestSlot& slot ) {
+        return reinterpret_cast<BusMsg*>( reinterpret_cast<uintptr_t>( &slot ) | TOKEN_TAG );
+    }
+
+    static bool isToken( const BusMsg* msg ) {
+        return reinterpret_cast<uintptr_t>( msg ) & TOKEN_TAG;
+    }
+
+    /**
+     * @brief Take the message stored in the slot of a received token
+     */
+    static BusMsg* take( BusMsg* token ) {
+        auto slot = reinterpret_cast<LatestSlot*>( reinterpret_cast<uintptr_t>( token ) & ~TOKEN_TAG );
+        return slot->msg.exchange( nullptr, std::memory_order_acq_rel );
+    }
+
+private:
+    static bool isFree( const LatestSlot& slot ) {
+        return slot.topic == BusAddrInvalid || ( slot.isLeft && !slot.msg.load( std::memory_order_acquire ) );
+    }
+
+    static constexpr uintptr_t TOKEN_TAG = 1;
+    static_assert( alignof( LatestSlot ) > TOKEN_TAG, "LatestSlot address must leave the tag bit free" );
+
+    std::array<LatestSlot, SIZE> m_slots;
+};
+
+}  // namespace bus
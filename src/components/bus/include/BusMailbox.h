@@ -0,0 +1,249 @@
+#pragma once
+
+#include "BusConfig.h"
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+#include "freertos/FreeRTOS.h"
+
+#if USE_LOCK_FREE_MAILBOX
+#if USE_FREE_RTOS_MUTEX
+#include "freertos/task.h"
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+#else
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#endif
+
+namespace bus {
+
+struct BusMsg;
+
+/**
+ * @brief Mailbox lane of a message, lower value is drained first
+ */
+enum class Priority : uint8_t { Control, Normal, Bulk };
+
+constexpr std::size_t PRIORITY_LANES = 3;
+
+/**
+ * @brief Picks the lane to drain next
+ *
+ * Strict draining always takes the highest non-empty lane. Weighted draining
+ * gives every lane BUS_LANE_WEIGHT_* messages per round, so the bulk lane
+ * still progresses while control traffic is heavy.
+ */
+class LaneScheduler {
+public:
+    template <typename TryPop>
+    bool pop( BusMsg*& msg, TryPop tryPop ) {
+#if BUS_MAILBOX_WEIGHTED_DRAIN
+        for( int round = 0; round < 2; ++round ) {
+            for( std::size_t lane = 0; lane < PRIORITY_LANES; ++lane ) {
+                if( m_credits[lane] && tryPop( lane, msg ) ) {
+                    --m_credits[lane];
+                    return true;
+                }
+            }
+            m_credits = WEIGHTS;  // every lane with credits is empty, start a new round
+        }
+        return false;
+#else
+        for( std::size_t lane = 0; lane < PRIORITY_LANES; ++lane ) {
+            if( tryPop( lane, msg ) ) {
+                return true;
+            }
+        }
+        return false;
+#endif
+    }
+
+private:
+#if BUS_MAILBOX_WEIGHTED_DRAIN
+    static constexpr std::array<uint8_t, PRIORITY_LANES> WEIGHTS{ { BUS_LANE_WEIGHT_CONTROL, BUS_LANE_WEIGHT_NORMAL, BUS_LANE_WEIGHT_BULK } };
+    std::array<uint8_t, PRIORITY_LANES> m_credits = WEIGHTS;
+#endif
+};
+
+#if USE_LOCK_FREE_MAILBOX
+
+/**
+ * @brief Bounded multi-producer ring of message pointers
+ *
+ * Producers and the consumer synchronize on per-cell sequence numbers only.
+ */
+class MessageRing {
+public:
+    static constexpr std::size_t LENGTH = BUS_MAILBOX_LENGTH;
+    static_assert( LENGTH >= 2 && ( LENGTH & ( LENGTH - 1 ) ) == 0, "BUS_MAILBOX_LENGTH must be a power of two" );
+
+    MessageRing();
+
+    MessageRing( const MessageRing& other ) = delete;
+    MessageRing& operator=( const MessageRing& other ) = delete;
+
+    bool tryPush( BusMsg* msg );
+    bool tryPop( BusMsg*& msg );
+
+    /**
+     * @brief Queued messages, approximate while producers are pushing
+     */
+    std::size_t size() const {
+        return m_pushPos.load( std::memory_order_relaxed ) - m_popPos.load( std::memory_order_relaxed );
+    }
+
+    bool isFull() const {
+        return size() >= LENGTH;
+    }
+
+private:
+    static constexpr uint32_t MASK = LENGTH - 1;
+
+    struct Cell {
+        std::atomic<uint32_t> sequence;
+        BusMsg* msg;
+    };
+    std::array<Cell, LENGTH> m_cells;
+    std::atomic<uint32_t> m_pushPos{ 0 };
+    std::atomic<uint32_t> m_popPos{ 0 };
+};
+
+/**
+ * @brief Lock-free rings of message pointers, one per priority lane
+ *
+ * The owner task blocks on its task notification (or a condition variable
+ * when built with std::mutex) and producers wake it only when it waits.
+ * Only one task may receive from a mailbox, its task notification is
+ * reserved for the mailbox.
+ */
+class Mailbox {
+public:
+    static constexpr std::size_t LENGTH = MessageRing::LENGTH;
+
+    Mailbox() = default;
+
+    Mailbox( const Mailbox& other ) = delete;
+    Mailbox& operator=( const Mailbox& other ) = delete;
+
+    bool create() {
+        return true;
+    }
+
+    void destroy() {}
+
+    bool isValid() const {
+        return true;
+    }
+
+    /**
+     * @brief Enqueue without blocking, false if the lane is full
+     */
+    bool push( BusMsg* msg, Priority priority = Priority::Normal );
+
+    /**
+     * @brief Dequeue waiting up to waitTime ticks for a message
+     */
+    bool pop( BusMsg*& msg, TickType_t waitTime );
+
+    /**
+     * @brief Queued messages of all lanes
+     */
+    std::size_t size() const {
+        std::size_t result = 0;
+        for( const auto& lane : m_lanes ) {
+            result += lane.size();
+        }
+        return result;
+    }
+
+    bool isFull( Priority priority ) const {
+        return m_lanes[static_cast<std::size_t>( priority )].isFull();
+    }
+
+    /**
+     * @brief Take the oldest message of a lane to make room for a newer one
+     */
+    bool evict( Priority priority, BusMsg*& msg ) {
+        return m_lanes[static_cast<std::size_t>( priority )].tryPop( msg );
+    }
+
+private:
+    bool tryPop( BusMsg*& msg );
+    void wakeUp();
+
+    std::array<MessageRing, PRIORITY_LANES> m_lanes;
+    LaneScheduler m_scheduler;
+
+#if USE_FREE_RTOS_MUTEX
+    std::atomic<TaskHandle_t> m_waiter{ nullptr };
+#else
+    std::atomic<bool> m_isWaiting{ false };
+    std::mutex m_waitMutex;
+    std::condition_variable m_wakeUp;
+#endif
+};
+
+#else
+
+/**
+ * @brief FreeRTOS queues of message pointers, one per priority lane
+ *
+ * A counting semaphore tracks the messages of all lanes, so the receiver
+ * blocks on a single object.
+ */
+class Mailbox {
+public:
+    static constexpr std::size_t LENGTH = BUS_MAILBOX_LENGTH;
+
+    Mailbox() = default;
+
+    Mailbox( const Mailbox& other ) = delete;
+    Mailbox& operator=( const Mailbox& other ) = delete;
+
+    bool create();
+    void destroy();
+
+    bool isValid() const {
+        return m_pending != nullptr;
+    }
+
+    /**
+     * @brief Enqueue without blocking, false if the lane is full
+     */
+    bool push( BusMsg* msg, Priority priority = Priority::Normal );
+
+    /**
+     * @brief Dequeue waiting up to waitTime ticks for a message
+     */
+    bool pop( BusMsg*& msg, TickType_t waitTime );
+
+    /**
+     * @brief Queued messages of all lanes
+     */
+    std::size_t size() const;
+
+    bool isFull( Priority priority ) const;
+
+    /**
+     * @brief Take the oldest message of a lane to make room for a newer one
+     *
+     * The pending count is left as is, the receiver may wake up once
+     * without a message.
+     */
+    bool evict( Priority priority, BusMsg*& msg );
+
+private:
+    std::array<QueueHandle_t, PRIORITY_LANES> m_lanes{};
+    SemaphoreHandle_t m_pending = nullptr;
+    LaneScheduler m_scheduler;
+};
+
+#endif
+
+}  // namespace bus
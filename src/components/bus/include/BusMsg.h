@@ -0,0 +1,199 @@
+#pragma once
+
+#include "BusAddr.h"
+#include "BusCommand.h"
+#include "BusCommandList.h"
+#include "BusConfig.h"
+#include "BusMailbox.h"
+#include "BusMutex.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace bus {
+
+/**
+ * @brief Small buffer for a bus command
+ *
+ * Commands listed in command::Variant are kept in place as the variant,
+ * other commands that fit into INLINE_SIZE bytes are constructed in place,
+ * a command passed as std::unique_ptr keeps its own heap storage.
+ */
+class CommandStorage {
+public:
+    static constexpr std::size_t INLINE_SIZE = std::max<std::size_t>( BUS_COMMAND_INLINE_SIZE, sizeof( command::Variant ) );
+
+    template <typename Cmd>
+    static constexpr bool fitsInline() {
+        return sizeof( Cmd ) <= INLINE_SIZE && alignof( Cmd ) <= alignof( std::max_align_t );
+    }
+
+    CommandStorage() = default;
+
+    ~CommandStorage() {
+        reset();
+    }
+
+    CommandStorage( const CommandStorage& other ) = delete;
+    CommandStorage& operator=( const CommandStorage& other ) = delete;
+
+    template <typename Cmd, typename... Args>
+    void emplace( Args&&... args ) {
+        static_assert( std::is_base_of<IBusCommand, Cmd>::value, "Bus command must implement IBusCommand" );
+        static_assert( fitsInline<Cmd>(), "Bus command is too big, increase BUS_COMMAND_INLINE_SIZE" );
+        reset();
+        if constexpr( command::IsListed<Cmd>::value ) {
+            auto variant = new( m_buffer ) command::Variant( std::in_place_type<Cmd>, std::forward<Args>( args )... );
+            m_command = &std::get<Cmd>( *variant );
+            m_kind = Kind::Variant;
+        }
+        else {
+            m_command = new( m_buffer ) Cmd( std::forward<Args>( args )... );
+            m_kind = Kind::Inline;
+        }
+    }
+
+    void adopt( std::unique_ptr<IBusCommand> command ) {
+        reset();
+        m_command = command.release();
+        m_kind = m_command ? Kind::Heap : Kind::Empty;
+    }
+
+    void reset() {
+        switch( m_kind ) {
+            case Kind::Variant:
+                std::destroy_at( std::launder( reinterpret_cast<command::Variant*>( m_buffer ) ) );
+                break;
+            case Kind::Inline:
+                m_command->~IBusCommand();
+                break;
+            case Kind::Heap:
+                delete m_command;
+                break;
+            case Kind::Empty:
+                break;
+        }
+        m_command = nullptr;
+        m_kind = Kind::Empty;
+    }
+
+    const IBusCommand* get() const {
+        return m_command;
+    }
+
+    /**
+     * @brief Listed command or nullptr if the command is only reachable through get()
+     */
+    const command::Variant* variant() const {
+        return m_kind == Kind::Variant ? std::launder( reinterpret_cast<const command::Variant*>( m_buffer ) ) : nullptr;
+    }
+
+private:
+    enum class Kind : uint8_t { Empty, Heap, Inline, Variant };
+
+    alignas( std::max_align_t ) unsigned char m_buffer[INLINE_SIZE];
+    IBusCommand* m_command = nullptr;
+    Kind m_kind = Kind::Empty;
+};
+
+class BusMsgPool;
+
+/**
+ * @brief Bus message shared by all receivers
+ *
+ * The message is immutable once it was enqueued, every mailbox holds
+ * its own reference and the last released reference returns it to the pool.
+ */
+struct BusMsg {
+    BusAddr from = BusAddrInvalid;
+    BusAddr to = BusAddrInvalid;
+    Priority priority = Priority::Normal;
+    uint64_t key = 0;  // replaces undelivered messages of the same key on latest-value topics
+    uint32_t correlation = 0;  // RPC request or response, see PendingCalls
+    bool isResponse = false;
+#if BUS_ENABLE_STATS
+    int64_t enqueuedAtUs = 0;
+#endif
+    CommandStorage command;
+
+    void addRef() {
+        m_refs.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+private:
+    friend class BusMsgPool;
+
+    BusMsgPool* m_pool = nullptr;
+    std::atomic<uint16_t> m_next{ 0 };  // free list link, index + 1 of the next free message
+    std::atomic<uint32_t> m_refs{ 0 };
+};
+
+struct BusMsgDeleter {
+    void operator()( BusMsg* msg ) const;
+};
+
+/**
+ * @brief Owner of a single reference to a pooled message
+ */
+using BusMsgPtr = std::unique_ptr<BusMsg, BusMsgDeleter>;
+
+/**
+ * @brief Fixed-size storage of bus messages
+ *
+ * acquire() never falls back to the heap, an empty pool is counted
+ * in Stats::exhausted and the message is not sent.
+ *
+ * The free list is a lock-free stack, receivers return their messages
+ * without waiting for a sender that holds the bus mutex. The head carries
+ * a 16 bit tag bumped by every change against the ABA problem.
+ */
+class BusMsgPool {
+public:
+    static constexpr std::size_t SIZE = BUS_MESSAGE_POOL_SIZE;
+    static_assert( SIZE < UINT16_MAX, "BUS_MESSAGE_POOL_SIZE is too big for the free list" );
+
+    struct Stats {
+        uint32_t capacity = SIZE;
+        uint32_t inUse = 0;
+        uint32_t highWater = 0;
+        uint32_t exhausted = 0;
+    };
+
+    BusMsgPool();
+
+    BusMsgPool( const BusMsgPool& other ) = delete;
+    BusMsgPool& operator=( const BusMsgPool& other ) = delete;
+
+    BusMsgPtr acquire( const BusAddr from, const BusAddr to, const Priority priority = Priority::Normal );
+
+    /**
+     * @brief Drop one reference, the message returns to the pool with the last one
+     */
+    static void release( BusMsg* msg );
+
+    /**
+     * @brief Snapshot of the counters, not consistent with each other while messages are moving
+     */
+    Stats stats() const;
+
+private:
+    static constexpr uint32_t INDEX_MASK = 0xFFFF;
+    static constexpr uint32_t TAG_STEP = 0x10000;
+
+    void free( BusMsg* msg );
+
+    std::array<BusMsg, SIZE> m_messages;
+    std::atomic<uint32_t> m_free{ 0 };  // tag << 16 | index + 1 of the first free message
+    std::atomic<uint32_t> m_inUse{ 0 };
+    std::atomic<uint32_t> m_highWater{ 0 };
+    std::atomic<uint32_t> m_exhausted{ 0 };
+};
+
+}  // namespace bus
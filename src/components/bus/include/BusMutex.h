@@ -0,0 +1,81 @@
+#pragma once
+
+#include "BusConfig.h"
+
+#if USE_FREE_RTOS_MUTEX
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#else
+#include <mutex>
+#endif
+
+namespace bus {
+
+#if USE_FREE_RTOS_MUTEX
+class FreeRtosMutex {
+public:
+    FreeRtosMutex()
+    : m_semaphore( xSemaphoreCreateMutex() ) {}
+
+    ~FreeRtosMutex() {
+        vSemaphoreDelete( m_semaphore );
+        m_semaphore = nullptr;
+    }
+
+    FreeRtosMutex( const FreeRtosMutex& other ) = delete;
+    FreeRtosMutex( const FreeRtosMutex&& other ) = delete;
+    FreeRtosMutex& operator=( const FreeRtosMutex& other ) = delete;
+
+    inline bool lock() {
+        return ( pdPASS == xSemaphoreTake( m_semaphore, portMAX_DELAY ) );
+    }
+
+    inline bool release() {
+        return ( pdPASS == xSemaphoreGive( m_semaphore ) );
+    }
+
+private:
+    SemaphoreHandle_t m_semaphore;
+};
+
+class FreeRtosMutexLock {
+public:
+    explicit FreeRtosMutexLock( FreeRtosMutex& lock )
+    : m_lock( lock ) {
+        m_isLocked = m_lock.lock();
+    }
+
+    ~FreeRtosMutexLock() {
+        release();
+    }
+
+    FreeRtosMutexLock( const FreeRtosMutexLock& other ) = delete;
+    FreeRtosMutexLock( const FreeRtosMutexLock&& other ) = delete;
+    FreeRtosMutexLock& operator=( const FreeRtosMutexLock& other ) = delete;
+
+    inline bool isLocked() const {
+        return m_isLocked;
+    }
+
+    inline bool release() {
+        if( m_isLocked ) {
+            m_isLocked = !m_lock.release();
+        }
+
+        return !m_isLocked;
+    }
+
+private:
+    FreeRtosMutex &m_lock;
+    bool m_isLocked = false;
+};
+
+using MutexType = FreeRtosMutex;
+using LockGuardType = FreeRtosMutexLock;
+
+#else
+using MutexType = std::mutex;
+using LockGuardType = std::lock_guard<std::mutex>;
+#endif
+
+}  // namespace bus
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "BusAddr.h"
+#include "BusCommand.h"
+#include "BusConfig.h"
+
+#include <stdint.h>
+#include <array>
+#include <cstddef>
+
+#include "freertos/FreeRTOS.h"
+
+namespace bus {
+
+enum class RpcResult : uint8_t {
+    Ok,       // response is passed to the callback
+    Timeout,  // no response until the deadline
+    Cancelled // IBusClient::cancelCalls() or the client was destroyed
+};
+
+/**
+ * @brief Completion of a call, response is nullptr unless result is RpcResult::Ok
+ */
+using RpcCallback = void ( * )( void* context, RpcResult result, const BusAddr from, const IBusCommand* response );
+
+/**
+ * @brief Request being received, needed to reply
+ */
+struct RpcRequest {
+    BusAddr from = BusAddrInvalid;
+    uint32_t correlation = 0;  // 0 - not a request
+
+    bool isValid() const {
+        return correlation != 0;
+    }
+};
+
+/**
+ * @brief Outstanding calls of a client in preallocated slots
+ *
+ * A correlation ID is ( generation << 8 | slot ), a response finds its slot
+ * without a search and a late response of a reused slot is recognized by
+ * the generation. Only the task owning the client touches the table.
+ */
+class PendingCalls {
+public:
+    static constexpr std::size_t SIZE = BUS_RPC_SLOTS;
+    static_assert( SIZE > 0 && SIZE <= 256, "BUS_RPC_SLOTS must fit into the slot byte of a correlation ID" );
+
+    /**
+     * @brief Reserve a slot, 0 if every slot is taken
+     */
+    uint32_t open( RpcCallback callback, void* context, TickType_t timeout );
+
+    /**
+     * @brief Release the slot of a call that was not sent, the callback is not invoked
+     */
+    void discard( uint32_t correlation );
+
+    /**
+     * @brief Invoke the callback of the call, false for an unknown or expired correlation
+     */
+    bool complete( uint32_t correlation, RpcResult result, const BusAddr from, const IBusCommand* response );
+
+    /**
+     * @brief Complete every outstanding call with RpcResult::Cancelled
+     */
+    void cancelAll();
+
+    /**
+     * @brief Time out the calls with a passed deadline
+     */
+    void expire( TickType_t now );
+
+    /**
+     * @brief Ticks until the nearest deadline, portMAX_DELAY without outstanding calls
+     */
+    TickType_t timeToDeadline( TickType_t now ) const;
+
+    std::size_t outstanding() const {
+        return m_outstanding;
+    }
+
+private:
+    struct Call {
+        uint32_t generation = 0;
+        bool isActive = false;
+        RpcCallback callback = nullptr;
+        void* context = nullptr;
+        TickType_t start = 0;
+        TickType_t timeout = 0;
+    };
+
+    Call* find( uint32_t correlation );
+
+    std::array<Call, SIZE> m_calls;
+    std::size_t m_outstanding = 0;
+};
+
+}  // namespace bus
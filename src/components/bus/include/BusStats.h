@@ -0,0 +1,132 @@
+#pragma once
+
+#include "BusConfig.h"
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace bus {
+
+/**
+ * @brief Message counters of a client or a group
+ *
+ * For a client, sent and droppedUnresolved count the messages it sent,
+ * delivered and droppedFull count the messages addressed to its mailbox.
+ * For a group every member copy is counted separately.
+ */
+struct TrafficCounters {
+    uint32_t sent = 0;
+    uint32_t delivered = 0;
+    uint32_t droppedFull = 0;        // destination lane was full
+    uint32_t droppedUnresolved = 0;  // destination address is not connected or the group is empty
+
+    template <typename Stream>
+    bool write( Stream& stream ) const {
+        return stream.write( sent ) && stream.write( delivered ) && stream.write( droppedFull ) && stream.write( droppedUnresolved );
+    }
+
+    template <typename Stream>
+    bool read( Stream& stream ) {
+        return stream.read( sent ) && stream.read( delivered ) && stream.read( droppedFull ) && stream.read( droppedUnresolved );
+    }
+};
+
+struct ClientStats : public TrafficCounters {
+    uint32_t mailboxHighWater = 0;  // most messages queued at once, all lanes together
+    uint32_t coalesced = 0;         // undelivered messages of latest-value topics replaced by newer ones
+    uint32_t uncoalesced = 0;       // messages of latest-value topics queued as is, every latest slot was taken
+
+    template <typename Stream>
+    bool write( Stream& stream ) const {
+        return TrafficCounters::write( stream ) && stream.write( mailboxHighWater ) && stream.write( coalesced ) && stream.write( uncoalesced );
+    }
+
+    template <typename Stream>
+    bool read( Stream& stream ) {
+        return TrafficCounters::read( stream ) && stream.read( mailboxHighWater ) && stream.read( coalesced ) && stream.read( uncoalesced );
+    }
+};
+
+/**
+ * @brief Enqueue to receive latency in fixed buckets
+ *
+ * Bucket i counts latencies below LIMITS_US[i], the last bucket counts the rest.
+ */
+class LatencyHistogram {
+public:
+    static constexpr std::size_t BUCKETS = 8;
+    static constexpr std::array<uint32_t, BUCKETS - 1> LIMITS_US{ { 16, 64, 256, 1000, 4000, 16000, 64000 } };
+
+    using Counts = std::array<uint32_t, BUCKETS>;
+
+    void add( int64_t latencyUs ) {
+        std::size_t bucket = 0;
+        while( bucket < LIMITS_US.size() && latencyUs >= LIMITS_US[bucket] ) {
+            ++bucket;
+        }
+        m_counts[bucket].fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    Counts counts() const {
+        Counts result;
+        for( std::size_t i = 0; i < BUCKETS; ++i ) {
+            result[i] = m_counts[i].load( std::memory_order_relaxed );
+        }
+        return result;
+    }
+
+    void reset() {
+        for( auto& count : m_counts ) {
+            count.store( 0, std::memory_order_relaxed );
+        }
+    }
+
+private:
+    std::array<std::atomic<uint32_t>, BUCKETS> m_counts{};
+};
+
+/**
+ * @brief Bus wide statistics, also the telemetry message carrying them
+ *
+ * Serialized with the streams of the common component, e.g.
+ * messages::create( buffer, bus.stats() ).
+ */
+struct BusStats {
+    static const uint32_t ID = 0x6b1e52d4;
+
+    TrafficCounters total;
+    uint32_t poolInUse = 0;
+    uint32_t poolHighWater = 0;
+    uint32_t poolExhausted = 0;
+    LatencyHistogram::Counts latency{};
+
+    template <typename Stream>
+    bool write( Stream& stream ) const {
+        if( !total.write( stream ) || !stream.write( poolInUse ) || !stream.write( poolHighWater ) || !stream.write( poolExhausted ) ) {
+            return false;
+        }
+        for( auto count : latency ) {
+            if( !stream.write( count ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename Stream>
+    bool read( Stream& stream ) {
+        if( !total.read( stream ) || !stream.read( poolInUse ) || !stream.read( poolHighWater ) || !stream.read( poolExhausted ) ) {
+            return false;
+        }
+        for( auto& count : latency ) {
+            if( !stream.read( count ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+}  // namespace bus
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "BusAddr.h"
+#include "BusCommand.h"
+#include "BusConfig.h"
+#include "BusMsg.h"
+#include "BusMutex.h"
+
+#include <stdint.h>
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "freertos/FreeRTOS.h"
+
+namespace bus {
+
+/**
+ * @brief Handle of a scheduled send, see IBusClient::sendAt() and IBusClient::sendEvery()
+ */
+typedef uint32_t TimerId;
+constexpr TimerId TimerIdInvalid = 0;
+
+/**
+ * @brief Scheduled and periodic sends in a hashed timer wheel
+ *
+ * A timer is hashed into the wheel slot of its deadline tick, the slot lists
+ * timers of every revolution. expire() visits one slot per elapsed tick, so
+ * the cost of a tick is the number of timers sharing its slot, not the number
+ * of timers. A timer keeps its command and a fresh pooled message is composed
+ * on every firing, waiting timers take no messages from the pool. Periodic
+ * deadlines advance by the period from the previous deadline and don't drift.
+ */
+class TimerWheel {
+public:
+    static constexpr std::size_t SIZE = BUS_MAX_TIMERS;
+    static constexpr std::size_t SLOTS = BUS_TIMER_WHEEL_SLOTS;
+    static_assert( SIZE > 0 && SIZE <= 0x10000, "BUS_MAX_TIMERS must fit into the index half of a TimerId" );
+    static_assert( SLOTS > 0 && ( SLOTS & ( SLOTS - 1 ) ) == 0, "BUS_TIMER_WHEEL_SLOTS must be a power of two" );
+
+    struct Stats {
+        uint32_t capacity = SIZE;
+        uint32_t active = 0;
+        uint32_t highWater = 0;
+        uint32_t fired = 0;
+        uint32_t missed = 0;  // firings without a free pooled message
+    };
+
+    TimerWheel();
+
+    TimerWheel( const TimerWheel& other ) = delete;
+    TimerWheel& operator=( const TimerWheel& other ) = delete;
+
+    /**
+     * @brief Add a timer firing at the deadline tick and then every period ticks, 0 - once
+     *
+     * A deadline that already passed fires on the next expire().
+     * @return TimerIdInvalid if every timer is taken
+     */
+    template <typename Cmd>
+    TimerId schedule( BusAddr from, BusAddr to, Cmd&& cmd, Priority priority, TickType_t now, TickType_t deadline, TickType_t period ) {
+        using CmdType = typename std::decay<Cmd>::type;
+
+        LockGuardType lock( m_mutex );
+
+        auto timer = allocate( now );
+        if( !timer ) {
+            return TimerIdInvalid;
+        }
+        timer->command.emplace<CmdType>( std::forward<Cmd>( cmd ) );
+        timer->copy = &copyCommand<CmdType>;
+        timer->from = from;
+        timer->to = to;
+        timer->priority = priority;
+        timer->period = period;
+        timer->deadline = isBefore( deadline, m_cursor ) ? m_cursor : deadline;
+        link( *timer );
+        return id( *timer );
+    }
+
+    /**
+     * @brief Remove a timer, false if it already fired for the last time or was cancelled
+     */
+    bool cancel( TimerId timerId );
+
+    /**
+     * @brief Compose the messages of the timers due until the now tick
+     *
+     * Stops when maxDue messages are composed, the rest is returned by the next call.
+     * @return number of messages stored to due
+     */
+    std::size_t expire( TickType_t now, BusMsgPool& pool, BusMsgPtr* due, std::size_t maxDue );
+
+    /**
+     * @brief Ticks until expire() has work, portMAX_DELAY without timers
+     */
+    TickType_t timeToNext( TickType_t now );
+
+    Stats stats();
+
+private:
+    using CopyFunction = void ( * )( const CommandStorage& from, CommandStorage& to );
+
+    struct Timer {
+        CommandStorage command;
+        CopyFunction copy = nullptr;
+        BusAddr from = BusAddrInvalid;
+        BusAddr to = BusAddrInvalid;
+        Priority priority = Priority::Normal;
+        bool isActive = false;
+        uint16_t generation = 0;
+        TickType_t deadline = 0;
+        TickType_t period = 0;
+        Timer* prev = nullptr;  // slot list or free list links
+        Timer* next = nullptr;
+    };
+
+    template <typename Cmd>
+    static void copyCommand( const CommandStorage& from, CommandStorage& to ) {
+        to.emplace<Cmd>( static_cast<const Cmd&>( *from.get() ) );
+    }
+
+    /**
+     * @brief a < b for ticks that may wrap around
+     */
+    static bool isBefore( TickType_t a, TickType_t b ) {
+        return static_cast<std::make_signed<TickType_t>::type>( a - b ) < 0;
+    }
+
+    TimerId id( const Timer& timer ) const {
+        return static_cast<TimerId>( timer.generation ) << 16 | static_cast<TimerId>( &timer - m_timers.data() );
+    }
+
+    Timer* allocate( TickType_t now );
+    void free( Timer& timer );
+    void link( Timer& timer );
+    void unlink( Timer& timer );
+
+    MutexType m_mutex;
+    std::array<Timer, SIZE> m_timers;
+    std::array<Timer*, SLOTS> m_slots{};
+    Timer* m_free = nullptr;
+    TickType_t m_cursor = 0;  // next tick to expire
+    Stats m_stats;
+};
+
+}  // namespace bus
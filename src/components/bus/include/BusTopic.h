@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <cstddef>
+
+namespace bus {
+
+/**
+ * @brief Group name hashed with 32-bit FNV-1a
+ *
+ * The bus keeps only the hash of a group name, names of the firmware are
+ * listed in BusTopicList.h where collisions are rejected at compile time.
+ */
+struct TopicId {
+    uint32_t value = 0;  // 0 - no topic
+
+    static constexpr TopicId hash( const char* name, std::size_t length ) {
+        uint32_t result = 2166136261u;
+        for( std::size_t i = 0; i < length; ++i ) {
+            result = ( result ^ static_cast<uint8_t>( name[i] ) ) * 16777619u;
+        }
+        return TopicId{ result ? result : 1u };  // 0 is reserved
+    }
+
+    static constexpr TopicId hash( const char* name ) {
+        std::size_t length = 0;
+        while( name[length] ) {
+            ++length;
+        }
+        return hash( name, length );
+    }
+
+    constexpr bool isValid() const {
+        return value != 0;
+    }
+
+    constexpr bool operator==( const TopicId& other ) const {
+        return value == other.value;
+    }
+
+    constexpr bool operator!=( const TopicId& other ) const {
+        return value != other.value;
+    }
+};
+
+template <std::size_t N>
+constexpr bool hasCollisions( const std::array<TopicId, N>& topics ) {
+    for( std::size_t i = 0; i < N; ++i ) {
+        for( std::size_t j = i + 1; j < N; ++j ) {
+            if( topics[i] == topics[j] ) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+inline namespace literals {
+
+constexpr TopicId operator""_topic( const char* name, std::size_t length ) {
+    return TopicId::hash( name, length );
+}
+
+}  // namespace literals
+
+}  // namespace bus
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "BusTopic.h"
+
+#include <array>
+
+namespace bus {
+namespace topic {
+
+constexpr TopicId Temperature = "temperature"_topic;
+constexpr TopicId Dimmer = "dimmer"_topic;
+constexpr TopicId Network = "network"_topic;
+constexpr TopicId Telemetry = "telemetry"_topic;
+
+/**
+ * @brief Topics of the firmware
+ *
+ * A new topic is added here, so that a hash collision with an existing
+ * one fails the build instead of merging the two groups.
+ */
+constexpr std::array<TopicId, 4> ALL{ { Temperature, Dimmer, Network, Telemetry } };
+
+static_assert( !hasCollisions( ALL ), "Topic names collide, rename one of them" );
+
+}  // namespace topic
+}  // namespace bus
@@ -3,275 +3,771 @@
 #include <algorithm>
 #include <freertos/task.h>
 
+#if BUS_ENABLE_STATS
+#include <esp_timer.h>
+#endif
+
 namespace bus {
 
 constexpr int IBusClient::MESSAGE_QUEUE_LENGTH;
 
-struct BusMsg {
-    const BusAddr from;
-    const BusAddr to;
-    std::list<BusAddr> destination;
-    std::unique_ptr<IBusCommand> msg;
-
-    BusMsg( const BusAddr _from,
-            const BusAddr _to,
-            std::list<BusAddr> _destination,
-            std::unique_ptr<IBusCommand>&& _msg )
-    : from( _from )
-    , to( _to )
-    , destination( std::move( _destination ) )
-    , msg( std::move( _msg ) ) {}
-};
+constexpr std::size_t CommandStorage::INLINE_SIZE;
+constexpr std::size_t BusMsgPool::SIZE;
+constexpr uint32_t BusMsgPool::INDEX_MASK;
+constexpr uint32_t BusMsgPool::TAG_STEP;
+constexpr std::size_t LatestTable::SIZE;
+constexpr uintptr_t LatestTable::TOKEN_TAG;
+
+#if BUS_ENABLE_STATS
+constexpr std::size_t LatencyHistogram::BUCKETS;
+constexpr std::array<uint32_t, LatencyHistogram::BUCKETS - 1> LatencyHistogram::LIMITS_US;
+const uint32_t BusStats::ID;
+#endif
+
+void BusMsgDeleter::operator()( BusMsg* msg ) const {
+    BusMsgPool::release( msg );
+}
+
+BusMsgPool::BusMsgPool() {
+    for( std::size_t i = 0; i < SIZE; ++i ) {
+        m_messages[i].m_pool = this;
+        m_messages[i].m_next.store( static_cast<uint16_t>( i + 1 < SIZE ? i + 2 : 0 ), std::memory_order_relaxed );
+    }
+    m_free.store( 1, std::memory_order_release );
+}
+
+BusMsgPtr BusMsgPool::acquire( const BusAddr from, const BusAddr to, const Priority priority ) {
+    BusMsg* msg = nullptr;
+    uint32_t head = m_free.load( std::memory_order_acquire );
+    uint32_t next = 0;
+    do {
+        const uint32_t index = head & INDEX_MASK;
+        if( !index ) {
+            m_exhausted.fetch_add( 1, std::memory_order_relaxed );
+            return nullptr;
+        }
+        msg = &m_messages[index - 1];
+        // A stale link fails the exchange, the tag changed meanwhile
+        next = ( ( head + TAG_STEP ) & ~INDEX_MASK ) | msg->m_next.load( std::memory_order_relaxed );
+    } while( !m_free.compare_exchange_weak( head, next, std::memory_order_acquire, std::memory_order_acquire ) );
+
+    const uint32_t inUse = m_inUse.fetch_add( 1, std::memory_order_relaxed ) + 1;
+    uint32_t highWater = m_highWater.load( std::memory_order_relaxed );
+    while( inUse > highWater && !m_highWater.compare_exchange_weak( highWater, inUse, std::memory_order_relaxed ) ) {
+    }
+
+    msg->m_refs.store( 1, std::memory_order_relaxed );
+    msg->from = from;
+    msg->to = to;
+    msg->priority = priority;
+    msg->key = 0;
+    msg->correlation = 0;
+    msg->isResponse = false;
+    return BusMsgPtr( msg );
+}
+
+void BusMsgPool::release( BusMsg* msg ) {
+    if( msg && 1 == msg->m_refs.fetch_sub( 1, std::memory_order_acq_rel ) ) {
+        msg->m_pool->free( msg );
+    }
+}
+
+void BusMsgPool::free( BusMsg* msg ) {
+    msg->command.reset();
+    m_inUse.fetch_sub( 1, std::memory_order_relaxed );
+
+    const uint32_t index = static_cast<uint32_t>( msg - m_messages.data() ) + 1;
+    uint32_t head = m_free.load( std::memory_order_relaxed );
+    uint32_t next = 0;
+    do {
+        msg->m_next.store( static_cast<uint16_t>( head & INDEX_MASK ), std::memory_order_relaxed );
+        next = ( ( head + TAG_STEP ) & ~INDEX_MASK ) | index;
+    } while( !m_free.compare_exchange_weak( head, next, std::memory_order_release, std::memory_order_relaxed ) );
+}
+
+BusMsgPool::Stats BusMsgPool::stats() const {
+    Stats stats;
+    stats.inUse = m_inUse.load( std::memory_order_relaxed );
+    stats.highWater = m_highWater.load( std::memory_order_relaxed );
+    stats.exhausted = m_exhausted.load( std::memory_order_relaxed );
+    return stats;
+}
+
+constexpr std::size_t Bus::MAX_CLIENTS;
+constexpr std::size_t Bus::MAX_GROUPS;
+constexpr std::size_t Bus::MAX_GROUP_MEMBERS;
+constexpr std::size_t Bus::TOPIC_INDEX_SIZE;
+
+Bus::Bus()
+: m_space( xSemaphoreCreateCounting( MAX_CLIENTS, 0 ) ) {}
+
+Bus::~Bus() {
+    if( m_space ) {
+        vSemaphoreDelete( m_space );
+        m_space = nullptr;
+    }
+}
+
+BusAddr Bus::nextClientAddr( std::size_t slot ) const {
+    const BusAddr first = -static_cast<BusAddr>( slot + 1 );
+    const BusAddr last = m_clients[slot].addr;
+    if( last == BusAddrInvalid || last < INT32_MIN + static_cast<BusAddr>( MAX_CLIENTS ) ) {
+        return first;
+    }
+    return last - static_cast<BusAddr>( MAX_CLIENTS );
+}
+
+void Bus::leaveAll( BusAddr clientAddr ) {
+    for( auto& group : m_groups ) {
+        auto end = group.destination.begin() + group.destinationCount;
+        auto i = std::find( group.destination.begin(), end, clientAddr );
+        if( i != end ) {
+            *i = *( end - 1 );
+            --group.destinationCount;
+        }
+    }
+}
 
 bool Bus::connect( IBusClient& client ) {
-    if( !client.m_queue ) {
+    if( !client.m_mailbox.isValid() ) {
         return false;
     }
 
     LockGuardType lock( m_mutex );
 
-    auto i = std::find_if( m_clients.begin(), m_clients.end(), [&client]( Bus::Client& other ) -> bool {
-        return client.m_queue == other.queue;
+    if( client.m_addr < BusAddrInvalid ) {
+        auto& other = m_clients[clientSlot( client.m_addr )];
+        if( other.addr == client.m_addr && other.mailbox == &client.m_mailbox ) {
+            return true;  // already connected
+        }
+    }
+
+    auto i = std::find_if( m_clients.begin(), m_clients.end(), []( const Bus::Client& other ) -> bool {
+        return !other.mailbox;
     } );
-    if( i != m_clients.end() ) {
-        client.m_addr = i->addr;  // already connected, recovery addr
-        return true;
+    if( i == m_clients.end() ) {
+        client.m_addr = BusAddrInvalid;
+        return false;
     }
 
-    client.m_addr = --m_addrLast;
-    m_clients.emplace_front( client.m_addr, client.m_queue );
+    const auto slot = static_cast<std::size_t>( i - m_clients.begin() );
+    i->addr = nextClientAddr( slot );
+    i->mailbox = &client.m_mailbox;
+    i->latest = &client.m_latest;
+#if BUS_ENABLE_STATS
+    i->stats = ClientStats();
+#endif
+    client.m_addr = i->addr;
 
     return true;
 }
 
 void Bus::disconnect( IBusClient& client ) {
-    if( !client.m_queue ) {
+    if( !client.m_mailbox.isValid() || client.m_addr >= BusAddrInvalid ) {
         return;
     }
 
-    LockGuardType lock( m_mutex );
+    {
+        LockGuardType lock( m_mutex );
 
-    std::remove_if( m_clients.begin(), m_clients.end(), [&client]( Bus::Client& other ) -> bool {
-        return client.m_queue == other.queue;
-    } );
-    client.m_addr = BusAddrInvalid;
+        auto& other = m_clients[clientSlot( client.m_addr )];
+        if( other.addr == client.m_addr ) {
+            other.mailbox = nullptr;
+            leaveAll( client.m_addr );
+            client.m_latest.release( BusAddrInvalid );
+        }
+        client.m_addr = BusAddrInvalid;
+    }
+    signalSpace();  // a sender blocked on the mailbox finds it gone
 }
 
 bool Bus::join( BusAddr addr, IBusClient& client ) {
-    if( addr <= BusAddrInvalid || client.m_addr >= BusAddrInvalid ) {
+    if( !isGroupAddr( addr ) || client.m_addr >= BusAddrInvalid ) {
         return false;
     }
 
     LockGuardType lock( m_mutex );
 
-    auto i = std::find_if(
-        m_groups.begin(), m_groups.end(), [&addr]( Bus::Group& group ) -> bool { return addr == group.addr; } );
-    if( i == m_groups.end() ) {
-        m_groups.emplace_front( addr );  // new group
-        i = m_groups.begin();
+    auto& group = m_groups[groupSlot( addr )];
+    if( group.addr == BusAddrInvalid ) {
+        group.addr = addr;  // new anonymous group
+        m_groupLast = std::max( m_groupLast, addr );
     }
 
-    auto j = std::find_if( i->destination.begin(), i->destination.end(), [&client]( BusAddr addr ) -> bool {
-        return client.m_addr == addr;
-    } );
-    if( j != i->destination.end() ) {
+    auto end = group.destination.begin() + group.destinationCount;
+    if( end != std::find( group.destination.begin(), end, client.m_addr ) ) {
         return true;
     }
+    if( group.destinationCount == MAX_GROUP_MEMBERS ) {
+        return false;
+    }
 
-    i->destination.emplace_front( client.m_addr );
+    group.destination[group.destinationCount++] = client.m_addr;
 
     return true;
 }
 
-bool Bus::join( const char* addrName, IBusClient& client ) {
-    if( !addrName ) {
-        return false;
+BusAddr Bus::findGroup( TopicId topic, bool isCreated ) {
+    if( !topic.isValid() ) {
+        return BusAddrInvalid;
     }
+
+    constexpr std::size_t mask = TOPIC_INDEX_SIZE - 1;
+    std::size_t cell = topic.value & mask;
+    while( m_topicIndex[cell] ) {
+        const auto& group = m_groups[m_topicIndex[cell] - 1];
+        if( group.topic == topic ) {
+            return group.addr;
+        }
+        cell = ( cell + 1 ) & mask;
+    }
+    if( !isCreated || !isGroupAddr( m_groupLast + 1 ) ) {
+        return BusAddrInvalid;
+    }
+
+    const BusAddr addr = ++m_groupLast;
+    auto& group = m_groups[groupSlot( addr )];  // new group
+    group.addr = addr;
+    group.topic = topic;
+    m_topicIndex[cell] = static_cast<uint16_t>( groupSlot( addr ) + 1 );
+    return addr;
+}
+
+bool Bus::join( TopicId topic, IBusClient& client ) {
     BusAddr addr = BusAddrInvalid;
     {
         LockGuardType lock( m_mutex );
 
-        auto i = std::find_if( m_groups.begin(), m_groups.end(), [&addrName]( Bus::Group& group ) -> bool {
-            return group.addrName == addrName;
-        } );
-        if( i == m_groups.end() ) {
-            addr = ++m_groupLast;
-            m_groups.emplace_front( addr, addrName );  // new group
-        }
-        else {
-            addr = i->addr;
+        addr = findGroup( topic, true );
+        if( addr == BusAddrInvalid ) {
+            return false;
         }
     }
 
     return join( addr, client );
 }
 
+bool Bus::join( const char* addrName, IBusClient& client ) {
+    return addrName && join( TopicId::hash( addrName ), client );
+}
+
+BusAddr Bus::coalesce( TopicId topic ) {
+    LockGuardType lock( m_mutex );
+
+    const BusAddr addr = findGroup( topic, true );
+    if( addr != BusAddrInvalid ) {
+        m_groups[groupSlot( addr )].isLatest = true;
+    }
+    return addr;
+}
+
+BusAddr Bus::coalesce( const char* addrName ) {
+    return addrName ? coalesce( TopicId::hash( addrName ) ) : BusAddrInvalid;
+}
+
 void Bus::leave( BusAddr addr, IBusClient& client ) {
-    if( addr <= BusAddrInvalid || client.m_addr >= BusAddrInvalid ) {
+    if( !isGroupAddr( addr ) || client.m_addr >= BusAddrInvalid ) {
         return;
     }
 
     LockGuardType lock( m_mutex );
 
-    auto i = std::find_if(
-        m_groups.begin(), m_groups.end(), [&addr]( Bus::Group& group ) -> bool { return addr == group.addr; } );
-    if( i == m_groups.end() ) {
-        return;
+    auto& group = m_groups[groupSlot( addr )];
+    auto end = group.destination.begin() + group.destinationCount;
+    auto i = std::find( group.destination.begin(), end, client.m_addr );
+    if( i != end ) {
+        *i = *( end - 1 );
+        --group.destinationCount;
+        client.m_latest.release( addr );
     }
+}
 
-    std::remove_if( i->destination.begin(), i->destination.end(), [&client]( BusAddr addr ) -> bool {
-        return client.m_addr == addr;
-    } );
+void Bus::leave( TopicId topic, IBusClient& client ) {
+    return leave( resolve( topic ), client );
 }
 
 void Bus::leave( const char* addrName, IBusClient& client ) {
-    if( !addrName ) {
-        return;
+    return leave( resolve( addrName ), client );
+}
+
+Bus::Client* Bus::findClient( BusAddr addr ) {
+    if( addr < 0 ) {
+        auto& client = m_clients[clientSlot( addr )];
+        if( client.addr == addr && client.mailbox ) {
+            return &client;
+        }
     }
-    BusAddr addr = BusAddrInvalid;
+
+    return nullptr;
+}
+
+Bus::Delivery Bus::enqueue( BusMsg& busMsg, BusAddr destination, DeliveryPolicy::Mode mode ) {
+    auto client = findClient( destination );
+    if( !client ) {
+        return Delivery::DroppedUnresolved;
+    }
+
+    if( isGroupAddr( busMsg.to ) && m_groups[groupSlot( busMsg.to )].isLatest ) {
+        if( auto slot = client->latest->find( busMsg.to, busMsg.key ) ) {
+            return enqueueLatest( *client, *slot, busMsg );
+        }
+#if BUS_ENABLE_STATS
+        ++client->stats.uncoalesced;
+#endif
+    }
+
+    busMsg.addRef();  // reference owned by the mailbox
+    bool isPushed = client->mailbox->push( &busMsg, busMsg.priority );
+    BusMsg* evicted = nullptr;
+    if( !isPushed && DeliveryPolicy::Mode::DropOldest == mode && client->mailbox->evict( busMsg.priority, evicted ) ) {
+        if( LatestTable::isToken( evicted ) ) {
+            evicted = LatestTable::take( evicted );  // the next message of the key queues a new token
+        }
+#if BUS_ENABLE_STATS
+        count( *evicted, destination, Delivery::DroppedFull );
+#endif
+        BusMsgPool::release( evicted );
+        isPushed = client->mailbox->push( &busMsg, busMsg.priority );
+    }
+    if( !isPushed ) {
+        BusMsgPool::release( &busMsg );
+        return Delivery::DroppedFull;
+    }
+    return Delivery::Delivered;
+}
+
+Bus::Delivery Bus::enqueueLatest( Client& client, LatestSlot& slot, BusMsg& busMsg ) {
+    busMsg.addRef();  // reference owned by the slot
+    BusMsg* older = slot.msg.exchange( &busMsg, std::memory_order_acq_rel );
+    if( older ) {
+        // The token of the slot is still queued and delivers the new message
+#if BUS_ENABLE_STATS
+        ++client.stats.coalesced;
+#endif
+        BusMsgPool::release( older );
+        return Delivery::Delivered;
+    }
+
+    if( client.mailbox->push( LatestTable::token( slot ), busMsg.priority ) ) {
+        return Delivery::Delivered;
+    }
+    // Without a queued token the receiver never touches the slot
+    slot.msg.store( nullptr, std::memory_order_relaxed );
+    BusMsgPool::release( &busMsg );
+    return Delivery::DroppedFull;
+}
+
+void Bus::dropFull( const BusMsg& busMsg, const BusAddr* full, std::size_t fullCount ) {
+#if BUS_ENABLE_STATS
+    for( std::size_t i = 0; i < fullCount; ++i ) {
+        count( busMsg, full[i], Delivery::DroppedFull );
+    }
+#endif
+}
+
+SendResult Bus::deliver( BusMsgPtr busMsg, DeliveryPolicy policy ) {
+    const BusAddr to = busMsg->to;
+#if BUS_ENABLE_STATS
+    busMsg->enqueuedAtUs = esp_timer_get_time();
+#endif
+
+    // Destinations with a full lane, retried by the blocking policy
+    std::array<BusAddr, MAX_GROUP_MEMBERS> full;
+    std::size_t fullCount = 0;
     {
+        // The pushes stay under the mutex: it keeps the mailboxes of the destinations
+        // connected, the group members and the latest slots stable, and makes the
+        // FailFast check hold until the enqueue. Only the mailbox pop and the pool
+        // are lock-free, receivers never take the bus mutex.
         LockGuardType lock( m_mutex );
 
-        auto i = std::find_if( m_groups.begin(), m_groups.end(), [&addrName]( Bus::Group& group ) -> bool {
-            return group.addrName == addrName;
-        } );
-        if( i == m_groups.end() ) {
-            return;
+        const BusAddr* destination = &to;
+        std::size_t destinationCount = to < 0 ? 1 : 0;
+        if( isGroupAddr( to ) ) {
+            const auto& group = m_groups[groupSlot( to )];
+            destination = group.destination.data();
+            destinationCount = group.destinationCount;
+        }
+
+        // A latest-value topic replaces the queued message of a key, its full lanes don't refuse it
+        const bool isLatest = isGroupAddr( to ) && m_groups[groupSlot( to )].isLatest;
+        if( DeliveryPolicy::Mode::FailFast == policy.mode && !isLatest ) {
+            // Only senders push and they hold the mutex, a lane with room keeps it until the loop below
+            for( std::size_t i = 0; i < destinationCount; ++i ) {
+                if( policy.isSenderExcluded && destination[i] == busMsg->from ) {
+                    continue;
+                }
+                auto client = findClient( destination[i] );
+                if( client && client->mailbox->isFull( busMsg->priority ) ) {
+                    full[fullCount++] = destination[i];
+                }
+            }
+            if( fullCount ) {
+                dropFull( *busMsg, full.data(), fullCount );
+#if BUS_ENABLE_STATS
+                countSent( *busMsg, true );
+#endif
+                return SendResult::Dropped;
+            }
+        }
+
+        bool isResolved = false;
+        for( std::size_t i = 0; i < destinationCount; ++i ) {
+            if( policy.isSenderExcluded && destination[i] == busMsg->from ) {
+                continue;
+            }
+            const auto delivery = enqueue( *busMsg, destination[i], policy.mode );
+            if( Delivery::DroppedFull == delivery ) {
+                full[fullCount++] = destination[i];
+            }
+#if BUS_ENABLE_STATS
+            else {
+                count( *busMsg, destination[i], delivery );
+            }
+#endif
+            isResolved = isResolved || Delivery::DroppedUnresolved != delivery;
+        }
+#if BUS_ENABLE_STATS
+        countSent( *busMsg, isResolved );
+#endif
+
+        if( !isResolved ) {
+            return SendResult::Unresolved;
+        }
+        if( DeliveryPolicy::Mode::Block != policy.mode || !fullCount ) {
+            dropFull( *busMsg, full.data(), fullCount );
+            return fullCount ? SendResult::Dropped : SendResult::Delivered;
+        }
+    }
+
+    // The receivers drain their mailboxes without the bus mutex, other senders may go on meanwhile.
+    // Every receiver that took messages gives m_space once per blocked sender, see signalSpace().
+    m_blockedSenders.fetch_add( 1 );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    const TickType_t start = xTaskGetTickCount();
+    bool isLost = false;  // a full destination disconnected while the sender waited
+    while( true ) {
+        {
+            // Retried once before the first wait, the room may have come before the sender counted
+            LockGuardType lock( m_mutex );
+
+            std::size_t stillFull = 0;
+            for( std::size_t i = 0; i < fullCount; ++i ) {
+                const auto delivery = enqueue( *busMsg, full[i], policy.mode );
+                if( Delivery::DroppedFull == delivery ) {
+                    full[stillFull++] = full[i];
+                }
+#if BUS_ENABLE_STATS
+                else {
+                    count( *busMsg, full[i], delivery );
+                }
+#endif
+                isLost = isLost || Delivery::DroppedUnresolved == delivery;
+            }
+            fullCount = stillFull;
         }
-        else {
-            addr = i->addr;
+
+        const TickType_t waited = xTaskGetTickCount() - start;
+        if( !fullCount || waited >= policy.timeout || !m_space ) {
+            break;
         }
+        xSemaphoreTake( m_space, policy.timeout - waited );
+    }
+    m_blockedSenders.fetch_sub( 1 );
+    if( !fullCount && !isLost ) {
+        return SendResult::Delivered;
     }
 
-    return leave( addr, client );
+    LockGuardType lock( m_mutex );
+
+    dropFull( *busMsg, full.data(), fullCount );
+    if( isLost && !isGroupAddr( to ) ) {
+#if BUS_ENABLE_STATS
+        countUnresolved( *busMsg );
+#endif
+        return SendResult::Unresolved;
+    }
+    return SendResult::Dropped;
 }
 
-std::list<BusAddr> Bus::destination( BusAddr addr ) {
-    if( addr < 0 ) {
-        return { addr };
+void Bus::wakeTimerTask() {
+    if( auto task = m_timerTask.load( std::memory_order_acquire ) ) {
+        xTaskNotifyGive( task );
     }
-    else if( addr > 0 ) {
-        LockGuardType lock( m_mutex );
+}
+
+void Bus::signalSpace() {
+    std::atomic_thread_fence( std::memory_order_seq_cst );  // pairs with the fence in deliver()
+    for( uint32_t waiters = m_blockedSenders.load( std::memory_order_relaxed ); waiters; --waiters ) {
+        xSemaphoreGive( m_space );
+    }
+}
+
+void Bus::serviceTimers( TickType_t waitTime ) {
+    m_timerTask.store( xTaskGetCurrentTaskHandle(), std::memory_order_release );
 
-        auto i = std::find_if(
-            m_groups.begin(), m_groups.end(), [&addr]( Bus::Group& group ) -> bool { return addr == group.addr; } );
-        if( i != m_groups.end() ) {
-            return i->destination;
+    const TickType_t wait = std::min( waitTime, m_timers.timeToNext( xTaskGetTickCount() ) );
+    if( wait ) {
+        ulTaskNotifyTake( pdTRUE, wait );
+    }
+
+    // Messages are delivered outside of the wheel mutex, senders may schedule meanwhile
+    std::array<BusMsgPtr, 16> due;
+    std::size_t count = 0;
+    do {
+        count = m_timers.expire( xTaskGetTickCount(), m_pool, due.data(), due.size() );
+        for( std::size_t i = 0; i < count; ++i ) {
+            deliver( std::move( due[i] ), DeliveryPolicy::dropNewest() );
         }
+    } while( count == due.size() );
+}
+
+void Bus::timerTask( void* bus ) {
+    for( ;; ) {
+        static_cast<Bus*>( bus )->serviceTimers( portMAX_DELAY );
     }
+}
 
-    return std::list<BusAddr>();
+#if BUS_ENABLE_STATS
+
+void Bus::count( TrafficCounters& counters, Delivery delivery ) {
+    switch( delivery ) {
+        case Delivery::Delivered:
+            ++counters.delivered;
+            break;
+        case Delivery::DroppedFull:
+            ++counters.droppedFull;
+            break;
+        case Delivery::DroppedUnresolved:
+            ++counters.droppedUnresolved;
+            break;
+    }
 }
 
-QueueHandle_t Bus::resolve( BusAddr addr ) {
-    if( addr < 0 ) {
-        auto i = std::find_if( m_clients.begin(), m_clients.end(), [&addr]( Bus::Client& client ) -> bool {
-            return addr == client.addr;
-        } );
-        if( i != m_clients.end() ) {
-            return i->queue;
+void Bus::count( const BusMsg& busMsg, BusAddr destination, Delivery delivery ) {
+    if( auto client = findClient( destination ) ) {
+        count( client->stats, delivery );
+        if( Delivery::Delivered == delivery ) {
+            client->stats.mailboxHighWater = std::max<uint32_t>( client->stats.mailboxHighWater, client->mailbox->size() );
         }
     }
+    if( Delivery::DroppedUnresolved != delivery ) {
+        count( m_total, delivery );  // unresolved sends are counted once per message by countSent()
+    }
+    if( isGroupAddr( busMsg.to ) ) {
+        count( m_groups[groupSlot( busMsg.to )].stats, delivery );
+    }
+}
 
-    return nullptr;
+void Bus::countSent( const BusMsg& busMsg, bool isResolved ) {
+    ++m_total.sent;
+    if( auto sender = findClient( busMsg.from ) ) {
+        ++sender->stats.sent;
+    }
+    if( !isResolved ) {
+        countUnresolved( busMsg );
+    }
+
+    if( isGroupAddr( busMsg.to ) ) {
+        auto& group = m_groups[groupSlot( busMsg.to )];
+        ++group.stats.sent;
+        if( !isResolved ) {
+            ++group.stats.droppedUnresolved;  // empty, or the sender was the only member
+        }
+    }
 }
 
-BusAddr Bus::resolve( const char* addrName ) {
-    if( !addrName ) {
-        return BusAddrInvalid;
+void Bus::countUnresolved( const BusMsg& busMsg ) {
+    ++m_total.droppedUnresolved;
+    if( auto sender = findClient( busMsg.from ) ) {
+        ++sender->stats.droppedUnresolved;
     }
+}
+
+BusStats Bus::stats() {
+    const auto pool = m_pool.stats();
+
+    BusStats result;
+    result.poolInUse = pool.inUse;
+    result.poolHighWater = pool.highWater;
+    result.poolExhausted = pool.exhausted;
+    result.latency = m_latency.counts();
 
     LockGuardType lock( m_mutex );
 
-    auto i = std::find_if( m_groups.begin(), m_groups.end(), [&addrName]( Bus::Group& group ) -> bool {
-        return group.addrName == addrName;
-    } );
-    if( i != m_groups.end() ) {
-        return i->addr;
+    result.total = m_total;
+    return result;
+}
+
+ClientStats Bus::clientStats( BusAddr addr ) {
+    LockGuardType lock( m_mutex );
+
+    auto client = findClient( addr );
+    return client ? client->stats : ClientStats();
+}
+
+TrafficCounters Bus::groupStats( BusAddr addr ) {
+    if( !isGroupAddr( addr ) ) {
+        return TrafficCounters();
+    }
+
+    LockGuardType lock( m_mutex );
+
+    return m_groups[groupSlot( addr )].stats;
+}
+
+void Bus::resetStats() {
+    LockGuardType lock( m_mutex );
+
+    m_total = TrafficCounters();
+    for( auto& client : m_clients ) {
+        client.stats = ClientStats();
     }
+    for( auto& group : m_groups ) {
+        group.stats = TrafficCounters();
+    }
+    m_latency.reset();
+}
+
+#endif
+
+Mailbox* Bus::resolve( BusAddr addr ) {
+    auto client = findClient( addr );
+    return client ? client->mailbox : nullptr;
+}
+
+BusAddr Bus::resolve( TopicId topic ) {
+    LockGuardType lock( m_mutex );
+
+    return findGroup( topic, false );
+}
 
-    return BusAddrInvalid;
+BusAddr Bus::resolve( const char* addrName ) {
+    return addrName ? resolve( TopicId::hash( addrName ) ) : BusAddrInvalid;
 }
 
 IBusClient::~IBusClient() {
     m_bus.disconnect( *this );
-    if( m_queue ) {
+    m_calls.cancelAll();
+    if( m_mailbox.isValid() ) {
         BusMsg* raw = nullptr;
-        while( pdTRUE == xQueueReceive( m_queue, (void*)&raw, (portTickType)0 ) && raw ) {
-            std::unique_ptr<BusMsg> busMsg( raw );
-            sendToNextClient( std::move( busMsg ) );
+        while( m_mailbox.pop( raw, 0 ) && raw ) {
+            BusMsgPool::release( LatestTable::isToken( raw ) ? LatestTable::take( raw ) : raw );
             raw = nullptr;
         }
-        vQueueDelete( m_queue );
-        m_queue = nullptr;
+        m_mailbox.destroy();
     }
 }
 
 bool IBusClient::initialize() {
-    if( !m_queue ) {
-        m_queue = xQueueCreate( MESSAGE_QUEUE_LENGTH, sizeof( BusMsg* ) );
-        if( m_queue ) {
-            m_bus.connect( *this );
-        }
+    if( BusAddrInvalid == m_addr && m_mailbox.create() ) {
+        m_bus.connect( *this );
     }
     return isConnectedToBus();
 }
 
 bool IBusClient::isConnectedToBus() {
-    return m_queue && ( BusAddrInvalid != m_addr );
+    return m_mailbox.isValid() && ( BusAddrInvalid != m_addr );
 }
 
-void IBusClient::send( const char* to, std::unique_ptr<IBusCommand> msg ) const {
+SendResult IBusClient::send( TopicId to, std::unique_ptr<IBusCommand> msg, Priority priority, DeliveryPolicy policy ) const {
+    if( !msg ) {
+        return SendResult::Unresolved;
+    }
+
+    return send( m_bus.resolve( to ), std::move( msg ), priority, policy );
+}
+
+SendResult IBusClient::send( const char* to, std::unique_ptr<IBusCommand> msg, Priority priority, DeliveryPolicy policy ) const {
     if( !to || !msg ) {
-        return;
+        return SendResult::Unresolved;
     }
 
-    send( m_bus.resolve( to ), std::move( msg ) );
+    return send( TopicId::hash( to ), std::move( msg ), priority, policy );
 }
 
-void IBusClient::send( BusAddr to, std::unique_ptr<IBusCommand> msg ) const {
+SendResult IBusClient::send( BusAddr to, std::unique_ptr<IBusCommand> msg, Priority priority, DeliveryPolicy policy ) const {
     if( to == BusAddrInvalid || !msg ) {
+        return SendResult::Unresolved;
+    }
+
+    auto busMsg = m_bus.m_pool.acquire( m_addr, to, priority );
+    if( !busMsg ) {
+        return SendResult::NoMemory;
+    }
+    busMsg->command.adopt( std::move( msg ) );
+    return m_bus.deliver( std::move( busMsg ), policy );
+}
+
+bool IBusClient::cancel( TimerId timer ) const {
+    return m_bus.m_timers.cancel( timer );
+}
+
+void IBusClient::dispatch( BusMsgPtr busMsg ) {
+#if BUS_ENABLE_STATS
+    m_bus.m_latency.add( esp_timer_get_time() - busMsg->enqueuedAtUs );
+#endif
+    if( busMsg->isResponse ) {
+        // A response of an expired call finds no slot and is dropped
+        m_calls.complete( busMsg->correlation, RpcResult::Ok, busMsg->from, busMsg->command.get() );
         return;
     }
 
-    std::unique_ptr<BusMsg> busMsg(
-        std::make_unique<BusMsg>( m_addr, to, std::move( m_bus.destination( to ) ), std::move( msg ) ) );
-    sendToNextClient( std::move( busMsg ) );
+    m_request = RpcRequest{ busMsg->from, busMsg->correlation };
+    if( auto variant = busMsg->command.variant() ) {
+        receive( busMsg->from, busMsg->to, *variant );
+    }
+    else {
+        receive( busMsg->from, busMsg->to, *busMsg->command.get() );
+    }
+    m_request = RpcRequest();
 }
 
 void IBusClient::tryReceive( TickType_t waitTime ) {
-    if( m_queue ) {
-        BusMsg* raw = nullptr;
-        if( pdTRUE == xQueueReceive( m_queue, (void*)&raw, (portTickType)waitTime ) && raw ) {
-            std::unique_ptr<BusMsg> busMsg( raw );
-            receive( busMsg->from, busMsg->to, busMsg->msg );
-            sendToNextClient( std::move( busMsg ) );
-            return;
-        }
-    }
-    vTaskDelay( waitTime );
+    drain( 1, waitTime );
 }
 
-void IBusClient::sendToNextClient( std::unique_ptr<BusMsg> busMsg ) const {
-    if( !busMsg || busMsg->destination.empty() ) {
-        return;
+std::size_t IBusClient::drain( std::size_t maxMessages, TickType_t waitTime ) {
+    if( !m_mailbox.isValid() ) {
+        vTaskDelay( waitTime );  // not created yet, keep the caller's loop from spinning
+        return 0;
     }
 
-    LockGuardType lock( m_bus.m_mutex );
+    if( m_calls.outstanding() ) {
+        m_calls.expire( xTaskGetTickCount() );
+        waitTime = std::min( waitTime, m_calls.timeToDeadline( xTaskGetTickCount() ) );
+    }
 
-    QueueHandle_t dest = nullptr;
-    do {  // try resolve valid client queue
-        dest = m_bus.resolve( busMsg->destination.back() );
-        busMsg->destination.pop_back();
-    } while( !busMsg->destination.empty() && !dest );
-    if( !dest ) {
-        return;
+    // An emptied latest token isn't a message, the wait goes on until the same deadline
+    const TickType_t start = xTaskGetTickCount();
+    auto remaining = [start, waitTime]() -> TickType_t {
+        if( waitTime == portMAX_DELAY ) {
+            return portMAX_DELAY;
+        }
+        const TickType_t waited = xTaskGetTickCount() - start;
+        return waited < waitTime ? waitTime - waited : 0;
+    };
+
+    std::size_t count = 0;
+    BusMsg* raw = nullptr;
+    while( count < maxMessages && m_mailbox.pop( raw, count ? 0 : remaining() ) && raw ) {
+        if( LatestTable::isToken( raw ) ) {
+            raw = LatestTable::take( raw );  // newest message of the key
+        }
+        if( raw ) {
+            dispatch( BusMsgPtr( raw ) );
+            ++count;
+        }
+        raw = nullptr;
+    }
+    if( count ) {
+        m_bus.signalSpace();
     }
 
-    auto raw = busMsg.get();
-    if( pdTRUE == xQueueSend( dest, (void*)&raw, (portTickType)0 ) ) {
-        busMsg.release();
+    if( m_calls.outstanding() ) {
+        m_calls.expire( xTaskGetTickCount() );
     }
+    return count;
 }
 
 }  // namespace bus
@@ -0,0 +1,232 @@
+#include "../include/BusMailbox.h"
+
+#include <chrono>
+
+namespace bus {
+
+constexpr std::size_t Mailbox::LENGTH;
+
+#if BUS_MAILBOX_WEIGHTED_DRAIN
+constexpr std::array<uint8_t, PRIORITY_LANES> LaneScheduler::WEIGHTS;
+#endif
+
+#if USE_LOCK_FREE_MAILBOX
+
+constexpr std::size_t MessageRing::LENGTH;
+constexpr uint32_t MessageRing::MASK;
+
+MessageRing::MessageRing() {
+    for( uint32_t i = 0; i < LENGTH; ++i ) {
+        m_cells[i].sequence.store( i, std::memory_order_relaxed );
+        m_cells[i].msg = nullptr;
+    }
+}
+
+bool MessageRing::tryPush( BusMsg* msg ) {
+    uint32_t pos = m_pushPos.load( std::memory_order_relaxed );
+    Cell* cell = nullptr;
+    while( true ) {
+        cell = &m_cells[pos & MASK];
+        const uint32_t sequence = cell->sequence.load( std::memory_order_acquire );
+        const int32_t diff = static_cast<int32_t>( sequence - pos );
+        if( diff == 0 ) {
+            if( m_pushPos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) {
+                break;
+            }
+        }
+        else if( diff < 0 ) {
+            return false;  // full
+        }
+        else {
+            pos = m_pushPos.load( std::memory_order_relaxed );
+        }
+    }
+
+    cell->msg = msg;
+    cell->sequence.store( pos + 1, std::memory_order_release );
+    return true;
+}
+
+bool MessageRing::tryPop( BusMsg*& msg ) {
+    uint32_t pos = m_popPos.load( std::memory_order_relaxed );
+    Cell* cell = nullptr;
+    while( true ) {
+        cell = &m_cells[pos & MASK];
+        const uint32_t sequence = cell->sequence.load( std::memory_order_acquire );
+        const int32_t diff = static_cast<int32_t>( sequence - ( pos + 1 ) );
+        if( diff == 0 ) {
+            if( m_popPos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) {
+                break;
+            }
+        }
+        else if( diff < 0 ) {
+            return false;  // empty
+        }
+        else {
+            pos = m_popPos.load( std::memory_order_relaxed );
+        }
+    }
+
+    msg = cell->msg;
+    cell->sequence.store( pos + MASK + 1, std::memory_order_release );
+    return true;
+}
+
+bool Mailbox::push( BusMsg* msg, Priority priority ) {
+    if( !m_lanes[static_cast<std::size_t>( priority )].tryPush( msg ) ) {
+        return false;
+    }
+    wakeUp();
+    return true;
+}
+
+bool Mailbox::tryPop( BusMsg*& msg ) {
+    return m_scheduler.pop( msg, [this]( std::size_t lane, BusMsg*& msg ) { return m_lanes[lane].tryPop( msg ); } );
+}
+
+#if USE_FREE_RTOS_MUTEX
+
+void Mailbox::wakeUp() {
+    // Orders the push before the waiter load, pairs with the fence in pop()
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    TaskHandle_t waiter = m_waiter.exchange( nullptr );
+    if( waiter ) {
+        xTaskNotifyGive( waiter );
+    }
+}
+
+bool Mailbox::pop( BusMsg*& msg, TickType_t waitTime ) {
+    if( tryPop( msg ) ) {
+        return true;
+    }
+    if( !waitTime ) {
+        return false;
+    }
+
+    const TickType_t start = xTaskGetTickCount();
+    TickType_t waited = 0;
+    do {
+        m_waiter.store( xTaskGetCurrentTaskHandle() );
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        if( tryPop( msg ) ) {  // pushed before the waiter was published
+            m_waiter.store( nullptr );
+            return true;
+        }
+        ulTaskNotifyTake( pdTRUE, waitTime == portMAX_DELAY ? portMAX_DELAY : waitTime - waited );
+        m_waiter.store( nullptr );
+        if( tryPop( msg ) ) {
+            return true;
+        }
+        waited = xTaskGetTickCount() - start;
+    } while( waitTime == portMAX_DELAY || waited < waitTime );
+
+    return false;
+}
+
+#else
+
+void Mailbox::wakeUp() {
+    // Without the fences the push and the flag store could both sit in store
+    // buffers, the producer would miss the waiter and the waiter the message
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    if( m_isWaiting.load() ) {
+        std::lock_guard<std::mutex> lock( m_waitMutex );
+        m_wakeUp.notify_one();
+    }
+}
+
+bool Mailbox::pop( BusMsg*& msg, TickType_t waitTime ) {
+    if( tryPop( msg ) ) {
+        return true;
+    }
+    if( !waitTime ) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock( m_waitMutex );
+    m_isWaiting.store( true );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    auto isReceived = [this, &msg] { return tryPop( msg ); };
+    bool result = false;
+    if( waitTime == portMAX_DELAY ) {
+        m_wakeUp.wait( lock, isReceived );
+        result = true;
+    }
+    else {
+        result = m_wakeUp.wait_for( lock, std::chrono::milliseconds( waitTime * portTICK_PERIOD_MS ), isReceived );
+    }
+    m_isWaiting.store( false );
+    return result;
+}
+
+#endif
+
+#else
+
+bool Mailbox::create() {
+    if( isValid() ) {
+        return true;
+    }
+
+    m_pending = xSemaphoreCreateCounting( LENGTH * PRIORITY_LANES, 0 );
+    bool isCreated = m_pending != nullptr;
+    for( auto& lane : m_lanes ) {
+        lane = isCreated ? xQueueCreate( LENGTH, sizeof( BusMsg* ) ) : nullptr;
+        isCreated = isCreated && lane;
+    }
+    if( !isCreated ) {
+        destroy();
+    }
+    return isCreated;
+}
+
+void Mailbox::destroy() {
+    for( auto& lane : m_lanes ) {
+        if( lane ) {
+            vQueueDelete( lane );
+            lane = nullptr;
+        }
+    }
+    if( m_pending ) {
+        vSemaphoreDelete( m_pending );
+        m_pending = nullptr;
+    }
+}
+
+bool Mailbox::push( BusMsg* msg, Priority priority ) {
+    if( pdTRUE != xQueueSend( m_lanes[static_cast<std::size_t>( priority )], (void*)&msg, (portTickType)0 ) ) {
+        return false;
+    }
+    xSemaphoreGive( m_pending );
+    return true;
+}
+
+bool Mailbox::pop( BusMsg*& msg, TickType_t waitTime ) {
+    if( pdTRUE != xSemaphoreTake( m_pending, waitTime ) ) {
+        return false;
+    }
+    // The taken count guarantees a message in one of the lanes unless a sender evicted it
+    return m_scheduler.pop( msg, [this]( std::size_t lane, BusMsg*& msg ) {
+        return pdTRUE == xQueueReceive( m_lanes[lane], (void*)&msg, (portTickType)0 );
+    } );
+}
+
+std::size_t Mailbox::size() const {
+    std::size_t result = 0;
+    for( auto lane : m_lanes ) {
+        result += uxQueueMessagesWaiting( lane );
+    }
+    return result;
+}
+
+bool Mailbox::isFull( Priority priority ) const {
+    return uxQueueMessagesWaiting( m_lanes[static_cast<std::size_t>( priority )] ) >= LENGTH;
+}
+
+bool Mailbox::evict( Priority priority, BusMsg*& msg ) {
+    return pdTRUE == xQueueReceive( m_lanes[static_cast<std::size_t>( priority )], (void*)&msg, (portTickType)0 );
+}
+
+#endif
+
+}  // namespace bus
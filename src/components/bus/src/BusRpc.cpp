@@ -0,0 +1,106 @@
+#include "../include/BusRpc.h"
+
+#include <freertos/task.h>
+
+namespace bus {
+
+constexpr std::size_t PendingCalls::SIZE;
+
+namespace {
+
+constexpr uint32_t SLOT_BITS = 8;
+constexpr uint32_t GENERATION_MASK = 0x00ffffff;
+
+}  // namespace
+
+uint32_t PendingCalls::open( RpcCallback callback, void* context, TickType_t timeout ) {
+    for( std::size_t slot = 0; slot < SIZE; ++slot ) {
+        auto& call = m_calls[slot];
+        if( call.isActive ) {
+            continue;
+        }
+
+        call.generation = ( call.generation + 1 ) & GENERATION_MASK;
+        if( !call.generation ) {
+            call.generation = 1;  // keeps the correlation ID of slot 0 non-zero
+        }
+        call.isActive = true;
+        call.callback = callback;
+        call.context = context;
+        call.start = xTaskGetTickCount();
+        call.timeout = timeout;
+        ++m_outstanding;
+        return call.generation << SLOT_BITS | static_cast<uint32_t>( slot );
+    }
+    return 0;
+}
+
+PendingCalls::Call* PendingCalls::find( uint32_t correlation ) {
+    const std::size_t slot = correlation & ( ( 1u << SLOT_BITS ) - 1 );
+    if( slot >= SIZE ) {
+        return nullptr;
+    }
+    auto& call = m_calls[slot];
+    return call.isActive && call.generation == correlation >> SLOT_BITS ? &call : nullptr;
+}
+
+void PendingCalls::discard( uint32_t correlation ) {
+    if( auto call = find( correlation ) ) {
+        call->isActive = false;
+        --m_outstanding;
+    }
+}
+
+bool PendingCalls::complete( uint32_t correlation, RpcResult result, const BusAddr from, const IBusCommand* response ) {
+    auto call = find( correlation );
+    if( !call ) {
+        return false;
+    }
+
+    call->isActive = false;  // the callback may issue the next call
+    --m_outstanding;
+    if( call->callback ) {
+        call->callback( call->context, result, from, response );
+    }
+    return true;
+}
+
+void PendingCalls::expire( TickType_t now ) {
+    if( !m_outstanding ) {
+        return;
+    }
+    for( std::size_t slot = 0; slot < SIZE; ++slot ) {
+        const auto& call = m_calls[slot];
+        if( call.isActive && call.timeout != portMAX_DELAY && now - call.start >= call.timeout ) {
+            complete( call.generation << SLOT_BITS | static_cast<uint32_t>( slot ), RpcResult::Timeout, BusAddrInvalid, nullptr );
+        }
+    }
+}
+
+void PendingCalls::cancelAll() {
+    for( std::size_t slot = 0; slot < SIZE && m_outstanding; ++slot ) {
+        const auto& call = m_calls[slot];
+        if( call.isActive ) {
+            complete( call.generation << SLOT_BITS | static_cast<uint32_t>( slot ), RpcResult::Cancelled, BusAddrInvalid, nullptr );
+        }
+    }
+}
+
+TickType_t PendingCalls::timeToDeadline( TickType_t now ) const {
+    TickType_t result = portMAX_DELAY;
+    if( !m_outstanding ) {
+        return result;
+    }
+    for( const auto& call : m_calls ) {
+        if( call.isActive && call.timeout != portMAX_DELAY ) {
+            const TickType_t elapsed = now - call.start;
+            const TickType_t left = elapsed < call.timeout ? call.timeout - elapsed : 0;
+            if( left < result ) {
+                result = left;
+            }
+        }
+    }
+    return result;
+}
+
+}  // namespace bus
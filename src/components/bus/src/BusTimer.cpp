@@ -0,0 +1,154 @@
+#include "../include/BusTimer.h"
+
+namespace bus {
+
+constexpr std::size_t TimerWheel::SIZE;
+constexpr std::size_t TimerWheel::SLOTS;
+
+TimerWheel::TimerWheel() {
+    for( auto& timer : m_timers ) {
+        timer.next = m_free;
+        m_free = &timer;
+    }
+}
+
+TimerWheel::Timer* TimerWheel::allocate( TickType_t now ) {
+    if( !m_free ) {
+        return nullptr;
+    }
+    if( !m_stats.active ) {
+        m_cursor = now;  // the wheel stood still without timers, don't replay the idle ticks
+    }
+
+    auto timer = m_free;
+    m_free = timer->next;
+    if( !++timer->generation ) {
+        timer->generation = 1;  // keeps the TimerId of timer 0 valid
+    }
+    timer->isActive = true;
+    if( ++m_stats.active > m_stats.highWater ) {
+        m_stats.highWater = m_stats.active;
+    }
+    return timer;
+}
+
+void TimerWheel::free( Timer& timer ) {
+    timer.command.reset();
+    timer.isActive = false;
+    timer.prev = nullptr;
+    timer.next = m_free;
+    m_free = &timer;
+    --m_stats.active;
+}
+
+void TimerWheel::link( Timer& timer ) {
+    auto& head = m_slots[timer.deadline & ( SLOTS - 1 )];
+    timer.prev = nullptr;
+    timer.next = head;
+    if( head ) {
+        head->prev = &timer;
+    }
+    head = &timer;
+}
+
+void TimerWheel::unlink( Timer& timer ) {
+    if( timer.prev ) {
+        timer.prev->next = timer.next;
+    }
+    else {
+        m_slots[timer.deadline & ( SLOTS - 1 )] = timer.next;
+    }
+    if( timer.next ) {
+        timer.next->prev = timer.prev;
+    }
+}
+
+bool TimerWheel::cancel( TimerId timerId ) {
+    const std::size_t index = timerId & 0xffff;
+    if( timerId == TimerIdInvalid || index >= SIZE ) {
+        return false;
+    }
+
+    LockGuardType lock( m_mutex );
+
+    auto& timer = m_timers[index];
+    if( !timer.isActive || timer.generation != timerId >> 16 ) {
+        return false;
+    }
+    unlink( timer );
+    free( timer );
+    return true;
+}
+
+std::size_t TimerWheel::expire( TickType_t now, BusMsgPool& pool, BusMsgPtr* due, std::size_t maxDue ) {
+    LockGuardType lock( m_mutex );
+
+    std::size_t count = 0;
+    if( !m_stats.active ) {
+        m_cursor = now + 1;
+        return count;
+    }
+
+    while( !isBefore( now, m_cursor ) ) {
+        auto timer = m_slots[m_cursor & ( SLOTS - 1 )];
+        while( timer ) {
+            auto next = timer->next;  // a periodic timer may be linked back into this slot
+            if( timer->deadline == m_cursor ) {
+                if( count == maxDue ) {
+                    return count;  // the cursor stays, the slot is visited again
+                }
+
+                if( auto busMsg = pool.acquire( timer->from, timer->to, timer->priority ) ) {
+                    timer->copy( timer->command, busMsg->command );
+                    due[count++] = std::move( busMsg );
+                    ++m_stats.fired;
+                }
+                else {
+                    ++m_stats.missed;
+                }
+
+                unlink( *timer );
+                if( timer->period ) {
+                    timer->deadline += timer->period;
+                    link( *timer );
+                }
+                else {
+                    free( *timer );
+                }
+            }
+            timer = next;
+        }
+        ++m_cursor;
+    }
+    return count;
+}
+
+TickType_t TimerWheel::timeToNext( TickType_t now ) {
+    LockGuardType lock( m_mutex );
+
+    if( !m_stats.active ) {
+        return portMAX_DELAY;
+    }
+    if( !isBefore( now, m_cursor ) ) {
+        return 0;
+    }
+
+    // One revolution ahead covers every slot, timers of later revolutions wake the task once per revolution
+    TickType_t tick = m_cursor;
+    for( std::size_t i = 0; i < SLOTS; ++i, ++tick ) {
+        for( auto timer = m_slots[tick & ( SLOTS - 1 )]; timer; timer = timer->next ) {
+            if( timer->deadline == tick ) {
+                return tick - now;
+            }
+        }
+    }
+    return tick - 1 - now;
+}
+
+TimerWheel::Stats TimerWheel::stats() {
+    LockGuardType lock( m_mutex );
+
+    return m_stats;
+}
+
+}  // namespace bus
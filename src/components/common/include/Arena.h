@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace streams {
+
+/**
+ * @brief Monotonic allocator for the containers decoded from one packet
+ *
+ * Allocations bump a pointer into the storage provided by the caller, the
+ * storage size is the byte budget of a packet. Nothing is freed one by one,
+ * release() drops everything at once after the handler returned.
+ *
+ * The containers can't be told that an allocation failed, so past the
+ * budget the arena falls back to the heap and reports isExhausted(); an
+ * InputBase decoding with the arena then fails at the next item, see
+ * InputBase::setArena(). The fallback blocks are freed by release().
+ */
+class Arena {
+public:
+    using SizeType = std::uint32_t;
+
+    Arena( void *buf, SizeType bufSize );
+
+    Arena( const Arena& ) = delete;
+    Arena& operator=( const Arena& ) = delete;
+
+    ~Arena();
+
+    void *allocate( std::size_t size, std::size_t alignment );
+
+    /**
+     * @brief Only the latest block is given back, e.g. when a vector grows
+     */
+    void deallocate( void *ptr, std::size_t size );
+
+    /**
+     * @brief Drop all allocations, O(1) unless the budget was exceeded
+     */
+    void release();
+
+    bool isExhausted() const;
+
+    SizeType capacity() const;
+
+    /**
+     * @brief Bytes allocated from the storage since the last release(), alignment padding included
+     */
+    SizeType used() const;
+
+    /**
+     * @brief Largest used() seen, helps to size the budget
+     */
+    SizeType highWater() const;
+
+private:
+    struct Overflow {
+        Overflow *next;
+    };
+
+    char *m_buf;
+    SizeType m_bufsize;
+    SizeType m_used = 0;
+    SizeType m_highWater = 0;
+    Overflow *m_overflow = nullptr;
+};
+
+/**
+ * @brief Standard allocator handing out the memory of an Arena
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator( Arena& arena )
+    : m_arena( &arena ) {}
+
+    template <typename U>
+    ArenaAllocator( const ArenaAllocator<U>& other )
+    : m_arena( &other.arena() ) {}
+
+    T *allocate( std::size_t itemsCount ) {
+        return static_cast<T *>( m_arena->allocate( itemsCount * sizeof( T ), alignof( T ) ) );
+    }
+
+    void deallocate( T *items, std::size_t itemsCount ) {
+        m_arena->deallocate( items, itemsCount * sizeof( T ) );
+    }
+
+    Arena& arena() const {
+        return *m_arena;
+    }
+
+    template <typename U>
+    bool operator==( const ArenaAllocator<U>& other ) const {
+        return m_arena == &other.arena();
+    }
+
+    template <typename U>
+    bool operator!=( const ArenaAllocator<U>& other ) const {
+        return !( *this == other );
+    }
+
+private:
+    Arena *m_arena;
+};
+
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+template <typename T>
+using ArenaList = std::list<T, ArenaAllocator<T>>;
+
+template <typename T>
+using ArenaSet = std::set<T, std::less<T>, ArenaAllocator<T>>;
+
+template <typename Key, typename Value>
+using ArenaMap = std::map<Key, Value, std::less<Key>, ArenaAllocator<std::pair<const Key, Value>>>;
+
+} // namespace streams
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "StreamTraits.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+namespace streams {
+
+/**
+ * @brief Read-only view of raw values inside a stream buffer, see InputBase::read( ArrayView<T>& )
+ *
+ * The values keep their wire position, which may be unaligned for T, so they
+ * are copied out one at a time on access instead of being dereferenced in
+ * place. The view is valid as long as the buffer of the stream it was read
+ * from.
+ */
+template <typename T>
+class ArrayView {
+    static_assert( IsRawValue<T>::value, "ArrayView holds raw values only" );
+
+public:
+    using SizeType = std::uint32_t;
+
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = T;
+
+        explicit Iterator( const char* data )
+        : m_data( data ) {}
+
+        T operator*() const {
+            T value;
+            std::memcpy( &value, m_data, sizeof( T ) );
+            return value;
+        }
+
+        Iterator& operator++() {
+            m_data += sizeof( T );
+            return *this;
+        }
+
+        Iterator operator++( int ) {
+            Iterator retval = *this;
+            ++( *this );
+            return retval;
+        }
+
+        bool operator==( const Iterator& other ) const {
+            return m_data == other.m_data;
+        }
+
+        bool operator!=( const Iterator& other ) const {
+            return !( *this == other );
+        }
+
+    private:
+        const char* m_data;
+    };
+
+    ArrayView() = default;
+
+    ArrayView( const char* data, SizeType itemsCount )
+    : m_data( data )
+    , m_itemsCount( itemsCount ) {}
+
+    T operator[]( SizeType index ) const {
+        return *Iterator( m_data + index * sizeof( T ) );
+    }
+
+    SizeType size() const {
+        return m_itemsCount;
+    }
+
+    bool empty() const {
+        return !m_itemsCount;
+    }
+
+    /**
+     * @brief Wire bytes of the values
+     */
+    const char* data() const {
+        return m_data;
+    }
+
+    Iterator begin() const {
+        return Iterator( m_data );
+    }
+
+    Iterator end() const {
+        return Iterator( m_data + m_itemsCount * sizeof( T ) );
+    }
+
+private:
+    const char* m_data = nullptr;
+    SizeType m_itemsCount = 0;
+};
+
+/**
+ * @brief View of a byte blob
+ */
+using ByteView = ArrayView<std::uint8_t>;
+
+} // namespace streams
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace crc {
+
+/**
+ * @brief CRC-16/ARC, reflected polynomial 0x8005, the CRC16 of the 1-Wire devices, check value 0xBB3D
+ *
+ * The checksum is 0 for no data, update() continues a checksum over more data.
+ */
+struct Crc16 {
+    using ValueType = std::uint16_t;
+
+    static constexpr ValueType INIT = 0x0000;
+    static constexpr ValueType XOR_OUT = 0x0000;
+
+    static ValueType update( ValueType crc, const void *data, std::size_t dataSize );
+};
+
+/**
+ * @brief CRC-32/ISO-HDLC, reflected polynomial 0x04C11DB7 of Ethernet and zlib, check value 0xCBF43926
+ */
+struct Crc32 {
+    using ValueType = std::uint32_t;
+
+    static constexpr ValueType INIT = 0xFFFFFFFF;
+    static constexpr ValueType XOR_OUT = 0xFFFFFFFF;
+
+    static ValueType update( ValueType crc, const void *data, std::size_t dataSize );
+};
+
+/**
+ * @brief Checksum of the data
+ */
+template <typename Crc>
+typename Crc::ValueType calculate( const void *data, std::size_t dataSize ) {
+    return Crc::update( Crc::INIT, data, dataSize ) ^ Crc::XOR_OUT;
+}
+
+} // namespace crc
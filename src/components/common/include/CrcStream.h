@@ -0,0 +1,135 @@
+#pragma once
+
+#include "Crc.h"
+#include "InputStream.h"
+#include "OutputStream.h"
+
+namespace streams {
+
+/**
+ * @brief Output stream computing the CRC of the bytes it passes on to another stream
+ *
+ * writeTrailer() appends the checksum, in the byte order of the fixed
+ * integers, after the message. Borrowed bytes stay borrowed, see
+ * SegmentedOutputStream. The integer encoding and container format are
+ * taken from the wrapped stream.
+ */
+template <typename Crc>
+class CrcOutputStream final : public OutputBase {
+public:
+    using CrcType = typename Crc::ValueType;
+
+    explicit CrcOutputStream( OutputBase& stream )
+    : m_stream( stream ) {
+        setIntegerEncoding( stream.integerEncoding() );
+        setContainerFormat( stream.containerFormat() );
+    }
+
+    SizeType write( const ValueType *data, const SizeType dataSize ) override {
+        const SizeType written = m_stream.write( data, dataSize );
+        m_crc = Crc::update( m_crc, data, written );
+        return written;
+    }
+
+    SizeType writeBorrowed( const ValueType *data, const SizeType dataSize ) override {
+        const SizeType written = m_stream.writeBorrowed( data, dataSize );
+        m_crc = Crc::update( m_crc, data, written );
+        return written;
+    }
+
+    using OutputBase::write;
+
+    /**
+     * @brief Flush the wrapped stream and start a new checksum
+     */
+    bool flush() override {
+        m_crc = Crc::INIT;
+        return m_stream.flush();
+    }
+
+    CrcType checksum() const {
+        return m_crc ^ Crc::XOR_OUT;
+    }
+
+    bool writeTrailer() {
+        const CrcType crc = checksum();
+        return sizeof( crc ) == m_stream.write( reinterpret_cast<const ValueType *>( &crc ), sizeof( crc ) );
+    }
+
+private:
+    OutputBase& m_stream;
+    CrcType m_crc = Crc::INIT;
+};
+
+/**
+ * @brief Input stream computing the CRC of the bytes it reads from another stream
+ *
+ * The last sizeof( CrcType ) bytes of the wrapped stream are the trailer,
+ * size() excludes them so a message can't read into it. verifyTrailer()
+ * compares the trailer with the checksum of the bytes read, a message is
+ * trusted after that only. Views read through consume() are checked too.
+ * Rewinding with reset() isn't supported, the checksum can't follow it.
+ */
+template <typename Crc>
+class CrcInputStream final : public InputBase {
+public:
+    using CrcType = typename Crc::ValueType;
+
+    explicit CrcInputStream( InputBase& stream )
+    : m_stream( stream ) {
+        setIntegerEncoding( stream.integerEncoding() );
+        setArena( stream.arena() );
+    }
+
+    SizeType read( ValuePtr data, const SizeType dataSize ) override {
+        const SizeType sizeRead = m_stream.read( data, std::min<SizeType>( dataSize, size() ) );
+        m_crc = Crc::update( m_crc, data, sizeRead );
+        return sizeRead;
+    }
+
+    using InputBase::read;
+
+    SizeType size() const override {
+        const SizeType streamSize = m_stream.size();
+        return streamSize > sizeof( CrcType ) ? streamSize - sizeof( CrcType ) : 0;
+    }
+
+    bool reset( const SizeType /*offset*/ ) override {
+        return false;
+    }
+
+    const ValueType* consume( const SizeType dataSize ) override {
+        if( dataSize > size() ) {
+            return nullptr;
+        }
+        auto data = m_stream.consume( dataSize );
+        if( data ) {
+            m_crc = Crc::update( m_crc, data, dataSize );
+        }
+        return data;
+    }
+
+    CrcType checksum() const {
+        return m_crc ^ Crc::XOR_OUT;
+    }
+
+    /**
+     * @brief Skip what's left of the message and compare its checksum with the trailer
+     */
+    bool verifyTrailer() {
+        ValueType chunk[64];
+        while( size() ) {
+            if( !read( chunk, std::min<SizeType>( sizeof( chunk ), size() ) ) ) {
+                return false;
+            }
+        }
+        CrcType crc;
+        return sizeof( crc ) == m_stream.read( reinterpret_cast<ValuePtr>( &crc ), sizeof( crc ) ) && crc == checksum();
+    }
+
+private:
+    InputBase& m_stream;
+    CrcType m_crc = Crc::INIT;
+};
+
+} // namespace streams
@@ -1,10 +1,19 @@
 #pragma once
 
+#include "Arena.h"
+#include "ArrayView.h"
+#include "Schema.h"
+#include "StreamTraits.h"
+#include "Varint.h"
+
+#include <algorithm>
 #include <cstdint>
 #include <iterator>
 #include <cstring>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <array>
 #include <list>
 #include <vector>
 #include <map>
@@ -13,122 +22,283 @@
 
 namespace streams {
 
-class InputBase {
-    enum class SerializationMarker : std::uint8_t { Item, End };
+class InputBase;
+
+template <typename Stream>
+class InputAdapter;
+
+/**
+ * @brief Decoding of values, containers and messages on top of the byte reads of Derived
+ *
+ * Derived provides read( ValuePtr, SizeType ), size() and consume(), see
+ * InputBase. InputBase makes them virtual, a concrete stream like
+ * ArrayReader has them inline and the decoding compiles down to plain
+ * loads. Objects decoding themselves from an InputBase& get an
+ * InputAdapter over a non-virtual stream.
+ */
+template <typename Derived>
+class BasicInput {
+    enum class SerializationMarker : std::uint8_t { Item, End, Counted };
+
+    static constexpr std::size_t CHUNK_SIZE = 256;  // stack buffer of the bulk container reads
 
 public:
-    using UPtr = std::unique_ptr<InputBase>;
     using SizeType = std::uint32_t;
     using ValueType = char;
     using ValuePtr = ValueType *;
 
-    virtual ~InputBase() = default;
+    IntegerEncoding integerEncoding() const {
+        return m_integerEncoding;
+    }
 
-    virtual SizeType read( ValuePtr data, const SizeType dataSize ) = 0;
+    /**
+     * @brief Wire format of the integers read further, must match the one of the writer
+     */
+    void setIntegerEncoding( const IntegerEncoding encoding ) {
+        m_integerEncoding = encoding;
+    }
 
-    virtual SizeType size() const {
-        return 0;
+    Arena* arena() const {
+        return m_arena;
     }
 
-    virtual bool reset( const SizeType offset ) {
-        return false;
+    /**
+     * @brief Arena of the containers decoded further, reads fail once its budget is exceeded
+     *
+     * The containers allocate with their own allocator, e.g. ArenaString and
+     * ArenaList built on the arena; items of arena containers are constructed
+     * with the allocator of the container.
+     */
+    void setArena( Arena* arena ) {
+        m_arena = arena;
     }
 
     template <typename ValueType, typename std::enable_if<std::is_integral<ValueType>::value || std::is_floating_point<ValueType>::value || std::is_enum<ValueType>::value, int>::type = 0>
     inline bool read( ValueType& value ) {
-        if( sizeof( ValueType ) > size() ) {
+        if constexpr( varint::IsWide<ValueType>::value ) {
+            if( IntegerEncoding::Varint == m_integerEncoding ) {
+                return readVarint( value );
+            }
+        }
+        if( sizeof( ValueType ) > self().size() ) {
             return false;
         }
-        return sizeof( ValueType ) == read( reinterpret_cast<char*>( &value ), sizeof( ValueType ) );
+        return sizeof( ValueType ) == self().read( reinterpret_cast<char*>( &value ), sizeof( ValueType ) );
     }
 
-    bool read( std::string& value ) {
-        SizeType itemsCount;
-        if( !read( itemsCount ) ) {
-            return false;
+    /**
+     * @brief Read a LEB128 varint regardless of the stream encoding, see OutputBase::writeVarint()
+     *
+     * Overlong encodings and values out of the range of ValueType are rejected.
+     */
+    template <typename ValueType>
+    bool readVarint( ValueType& value ) {
+        static_assert( varint::IsEncodable<ValueType>::value, "Only integers and enums are coded as varints" );
+        constexpr unsigned BITS = sizeof( ValueType ) * 8;
+        constexpr unsigned MAX_BYTES = varint::maxBytes<ValueType>();
+
+        std::uint64_t bits = 0;
+        for( unsigned i = 0; i < MAX_BYTES; ++i ) {
+            std::uint8_t byte;
+            if( 1 != self().read( reinterpret_cast<ValuePtr>( &byte ), 1 ) ) {
+                return false;
+            }
+            const std::uint64_t group = byte & 0x7f;
+            const unsigned shift = 7 * i;
+            if( i == MAX_BYTES - 1 && ( group >> ( BITS - shift ) ) ) {
+                return false;  // out of range
+            }
+            bits |= group << shift;
+            if( !( byte & 0x80 ) ) {
+                if( i && !group ) {
+                    return false;  // overlong, the last group carries no bits
+                }
+                value = varint::decode<ValueType>( bits );
+                return true;
+            }
         }
-        value.reserve( itemsCount );
-        auto beginItr = this->begin<std::string::traits_type::char_type>( itemsCount );
-        auto endItr = this->end<std::string::traits_type::char_type>();
-        value = std::move( std::string( beginItr, endItr ) );
-        return value.size() == itemsCount;
+        return false;  // continuation past the widest encoding
     }
 
-    template <typename T>
-    bool read( std::list<T>& list ) {
-        return readListLikeContainer( list );
+    template <typename Traits, typename Alloc>
+    bool read( std::basic_string<char, Traits, Alloc>& value ) {
+        SizeType itemsCount;
+        if( !read( itemsCount ) || !hasItems<char>( itemsCount ) ) {
+            return false;
+        }
+        value.resize( itemsCount );
+        return !isOverBudget() && readItems( &value[0], itemsCount );
     }
 
-    template <typename ValueType>
-    bool read( std::vector<ValueType>& vec ) {
+    /**
+     * @brief String in place, no copy is made, valid as long as the buffer of the stream
+     *
+     * Same wire format as std::string, false for streams without a contiguous buffer.
+     */
+    bool read( std::string_view& value ) {
         SizeType itemsCount;
         if( !read( itemsCount ) ) {
             return false;
         }
-        auto begin = this->begin<ValueType>( itemsCount );
-        auto end = this->end<ValueType>();
-        vec = std::move( std::vector<ValueType>( begin, end ) );
-        return vec.size() == itemsCount;
+        auto data = self().consume( itemsCount );
+        if( !data ) {
+            return false;
+        }
+        value = std::string_view( data, itemsCount );
+        return true;
     }
 
-    template <typename T>
-    bool read( std::unique_ptr<T>& uptr ) {
-        auto instanceUPtr = T::create( *this );
-        if( instanceUPtr ) {
-            uptr = std::move( instanceUPtr );
-            return true;
+    /**
+     * @brief Raw values in place, the wire format of a std::vector of them
+     *
+     * No copy is made, see ArrayView. False for streams without a contiguous
+     * buffer and for varint coded values.
+     */
+    template <typename ValueType>
+    bool read( ArrayView<ValueType>& view ) {
+        SizeType itemsCount;
+        return read( itemsCount ) && read( view, itemsCount );
+    }
+
+    /**
+     * @brief Fixed number of raw values in place, the wire format of a std::array of them
+     */
+    template <typename ValueType>
+    bool read( ArrayView<ValueType>& view, const SizeType itemsCount ) {
+        if( !isRawCoded<ValueType>() || !hasItems<ValueType>( itemsCount ) ) {
+            return false;
         }
-        else {
-            uptr = nullptr;
+        auto data = self().consume( itemsCount * sizeof( ValueType ) );
+        if( !data ) {
             return false;
         }
+        view = ArrayView<ValueType>( data, itemsCount );
+        return true;
     }
 
-    template <typename Key, typename Value>
-    bool read( std::unordered_map<Key, Value>& map ) {
-        return readMapLikeContainer( map );
+    template <typename T, typename Alloc>
+    bool read( std::list<T, Alloc>& list ) {
+        return readListLikeContainer( list );
     }
 
-    template <typename Key, typename Value>
-    bool read( std::map<Key, Value>& map ) {
-        return readMapLikeContainer( map );
+    template <typename ValueType, typename Alloc>
+    bool read( std::vector<ValueType, Alloc>& vec ) {
+        SizeType itemsCount;
+        if( !read( itemsCount ) ) {
+            return false;
+        }
+        if constexpr( IsRawVectorItem<ValueType>::value ) {
+            if( isRawCoded<ValueType>() ) {
+                if( !hasItems<ValueType>( itemsCount ) ) {
+                    return false;
+                }
+                vec.resize( itemsCount );
+                return !isOverBudget() && readItems( vec.data(), itemsCount );
+            }
+        }
+        if constexpr( varint::IsWide<ValueType>::value ) {
+            if( IntegerEncoding::Varint == m_integerEncoding ) {
+                // Varints are shorter than the items, the iterator bounds would stop early
+                if( itemsCount > self().size() ) {
+                    return false;
+                }
+                vec.resize( itemsCount );
+                for( auto& item : vec ) {
+                    if( !read( item ) ) {
+                        return false;
+                    }
+                }
+                return !isOverBudget();
+            }
+        }
+        if constexpr( !std::is_same<Alloc, std::allocator<ValueType>>::value ) {
+            // The iterator default constructs the items, those of arena containers need the allocator
+            if( itemsCount > self().size() ) {
+                return false;
+            }
+            vec.clear();
+            vec.reserve( itemsCount );
+            return readCountedItems( vec, itemsCount );
+        }
+        else {
+            auto begin = this->begin<ValueType>( itemsCount );
+            auto end = this->end<ValueType>();
+            vec = std::move( std::vector<ValueType>( begin, end ) );
+            return vec.size() == itemsCount;
+        }
     }
 
-    template <typename Value>
-    bool read( std::set<Value>& set ) {
-        SerializationMarker marker;
-        while( read( marker ) ) {
-            if( SerializationMarker::End == marker ) {
-                return true;
+    /**
+     * @brief Fixed number of items, no count is serialized
+     */
+    template <typename ValueType, std::size_t N>
+    bool read( std::array<ValueType, N>& items ) {
+        if constexpr( IsRawValue<ValueType>::value ) {
+            if( isRawCoded<ValueType>() ) {
+                return hasItems<ValueType>( N ) && readItems( items.data(), N );
             }
-            else if( SerializationMarker::Item != marker ) {
+        }
+        for( auto& item : items ) {
+            if( !read( item ) ) {
                 return false;
             }
+        }
+        return true;
+    }
 
-            Value val;
-            if( !read( val ) ) {
+    template <typename T>
+    bool read( std::unique_ptr<T>& uptr ) {
+        return withInputBase( [&uptr]( InputBase& stream ) {
+            auto instanceUPtr = T::create( stream );
+            if( instanceUPtr ) {
+                uptr = std::move( instanceUPtr );
+                return true;
+            }
+            else {
+                uptr = nullptr;
                 return false;
             }
-            set.insert( std::move( val ) );
-        }
-        return false;
+        } );
+    }
+
+    template <typename Key, typename Value, typename Hash, typename KeyEqual, typename Alloc>
+    bool read( std::unordered_map<Key, Value, Hash, KeyEqual, Alloc>& map ) {
+        return readMapLikeContainer( map );
     }
 
+    template <typename Key, typename Value, typename Compare, typename Alloc>
+    bool read( std::map<Key, Value, Compare, Alloc>& map ) {
+        return readMapLikeContainer( map );
+    }
+
+    template <typename Value, typename Compare, typename Alloc>
+    bool read( std::set<Value, Compare, Alloc>& set ) {
+        return readListLikeContainer( set );
+    }
+
+    /**
+     * @brief Fields of a schema, see Schema.h, or the read() member of the object
+     */
     template <typename T, typename std::enable_if<std::is_class<T>::value, int>::type = 0>
     inline bool read( T& object ) {
-        return object.read( *this );
+        if constexpr( HasFields<T>::value ) {
+            return std::apply( [this, &object]( auto... fields ) { return ( read( object.*fields ) && ... ); }, T::fields() );
+        }
+        else {
+            return withInputBase( [&object]( InputBase& stream ) { return object.read( stream ); } );
+        }
     }
 
     template <typename ValueType>
     class Iterator : public std::iterator<std::input_iterator_tag, ValueType> {
         static const int END_OF_ITERATIONS = -1;
 
-        InputBase& m_rstream;
+        Derived& m_rstream;
         int m_itemsLeft;
         ValueType m_value;
 
     public:
-        explicit Iterator( InputBase& rstream, int itemsCount = END_OF_ITERATIONS )
+        explicit Iterator( Derived& rstream, int itemsCount = END_OF_ITERATIONS )
         : m_rstream( rstream )
         , m_itemsLeft( itemsCount ) {
             ++( *this );
@@ -171,61 +341,266 @@ public:
 
     template <typename ValueType>
     Iterator<ValueType> begin( std::size_t itemsCount ) {
-        if( size() < itemsCount ) {
+        if( self().size() < itemsCount ) {
             return end<ValueType>();
         }
-        return Iterator<ValueType>( *this, itemsCount );
+        return Iterator<ValueType>( self(), itemsCount );
     }
 
     template <typename ValueType>
     Iterator<ValueType> end() {
-        return Iterator<ValueType>( *this );
+        return Iterator<ValueType>( self() );
     }
 
+protected:
+    BasicInput() = default;
+    ~BasicInput() = default;
+
 private:
+    Derived& self() {
+        return static_cast<Derived&>( *this );
+    }
+
+    const Derived& self() const {
+        return static_cast<const Derived&>( *this );
+    }
+
+    /**
+     * @brief Call function with the stream as an InputBase, through an InputAdapter for a non-virtual stream
+     */
+    template <typename Function>
+    bool withInputBase( Function function ) {
+        if constexpr( std::is_base_of<InputBase, Derived>::value ) {
+            return function( static_cast<InputBase&>( self() ) );
+        }
+        else {
+            InputAdapter<Derived> adapter( self() );
+            return function( adapter );
+        }
+    }
+
+    /**
+     * @brief Raw value read as its in-memory bytes by the stream encoding
+     */
+    template <typename ValueType>
+    bool isRawCoded() const {
+        return !varint::IsWide<ValueType>::value || IntegerEncoding::Fixed == m_integerEncoding;
+    }
+
+    /**
+     * @brief Single bounds check of a run of raw values, the count may come from a malformed message
+     */
+    template <typename ValueType>
+    bool hasItems( std::uint64_t itemsCount ) const {
+        return itemsCount * sizeof( ValueType ) <= self().size();
+    }
+
+    bool isOverBudget() const {
+        return m_arena && m_arena->isExhausted();
+    }
+
+    /**
+     * @brief Item for the container, constructed with its allocator if the item takes one
+     */
+    template <typename Item, typename Container>
+    static Item makeItem( const Container& container ) {
+        if constexpr( std::uses_allocator<Item, typename Container::allocator_type>::value ) {
+            return Item( container.get_allocator() );
+        }
+        else {
+            return Item();
+        }
+    }
+
+    template <typename ValueType>
+    bool readItems( ValueType* items, std::size_t itemsCount ) {
+        const SizeType dataSize = static_cast<SizeType>( itemsCount * sizeof( ValueType ) );
+        return dataSize == self().read( reinterpret_cast<ValuePtr>( items ), dataSize );
+    }
+
+    /**
+     * @brief Elements after a Counted marker, raw values are read in chunks
+     */
     template <typename Container>
-    bool readListLikeContainer( Container& list ) {
-        SerializationMarker marker;
-        while( read( marker ) ) {
-            if( SerializationMarker::End == marker ) {
+    bool readCountedItems( Container& list, SizeType itemsCount ) {
+        using Item = typename Container::value_type;
+        if constexpr( IsRawValue<Item>::value ) {
+            if( isRawCoded<Item>() ) {
+                if( !hasItems<Item>( itemsCount ) ) {
+                    return false;
+                }
+                constexpr SizeType CHUNK_ITEMS = CHUNK_SIZE / sizeof( Item ) ? CHUNK_SIZE / sizeof( Item ) : 1;
+                Item chunk[CHUNK_ITEMS];
+                while( itemsCount ) {
+                    const SizeType chunkItems = std::min( itemsCount, CHUNK_ITEMS );
+                    if( !readItems( chunk, chunkItems ) ) {
+                        return false;
+                    }
+                    for( SizeType i = 0; i < chunkItems; ++i ) {
+                        list.insert( list.end(), chunk[i] );
+                    }
+                    if( isOverBudget() ) {
+                        return false;
+                    }
+                    itemsCount -= chunkItems;
+                }
                 return true;
             }
-            else if( SerializationMarker::Item != marker ) {
+        }
+        for( ; itemsCount; --itemsCount ) {
+            Item item = makeItem<Item>( list );
+            if( !read( item ) ) {
                 return false;
             }
-
-            auto itr = list.emplace( list.end() );
-            if( !read( *itr ) ) {
+            list.insert( list.end(), std::move( item ) );
+            if( isOverBudget() ) {
                 return false;
             }
         }
-        return false;
+        return true;
     }
 
     template <typename Container>
-    bool readMapLikeContainer( Container& map ) {
+    bool readListLikeContainer( Container& list ) {
         SerializationMarker marker;
-        while( read( marker ) ) {
-            if( SerializationMarker::End == marker ) {
-                return true;
+        if( !read( marker ) ) {
+            return false;
+        }
+        if( SerializationMarker::Counted == marker ) {
+            SizeType itemsCount;
+            return read( itemsCount ) && readCountedItems( list, itemsCount );
+        }
+
+        while( SerializationMarker::Item == marker ) {
+            auto item = makeItem<typename Container::value_type>( list );
+            if( !read( item ) ) {
+                return false;
             }
-            else if( SerializationMarker::Item != marker ) {
+            list.insert( list.end(), std::move( item ) );
+            if( isOverBudget() || !read( marker ) ) {
                 return false;
             }
+        }
+        return SerializationMarker::End == marker;
+    }
 
-            typename Container::key_type key;
-            typename Container::mapped_type value;
-            if( !read( key ) || !read( value ) ) {
+    template <typename Key, typename Value, typename Hash, typename KeyEqual, typename Alloc>
+    void reserve( std::unordered_map<Key, Value, Hash, KeyEqual, Alloc>& map, SizeType itemsCount ) {
+        map.reserve( itemsCount );
+    }
+
+    template <typename Container>
+    void reserve( Container& map, SizeType itemsCount ) {}
+
+    template <typename Container>
+    bool readMapItem( Container& map ) {
+        auto key = makeItem<typename Container::key_type>( map );
+        auto value = makeItem<typename Container::mapped_type>( map );
+        if( !read( key ) || !read( value ) ) {
+            return false;
+        }
+
+        map.emplace( std::move( key ), std::move( value ) );
+        return !isOverBudget();
+    }
+
+    template <typename Container>
+    bool readMapLikeContainer( Container& map ) {
+        SerializationMarker marker;
+        if( !read( marker ) ) {
+            return false;
+        }
+        if( SerializationMarker::Counted == marker ) {
+            SizeType itemsCount;
+            if( !read( itemsCount ) ) {
                 return false;
             }
+            reserve( map, std::min( itemsCount, self().size() ) );  // a malformed count must not allocate
+            for( ; itemsCount; --itemsCount ) {
+                if( !readMapItem( map ) ) {
+                    return false;
+                }
+            }
+            return true;
+        }
 
-            map.emplace( key, value );
+        while( SerializationMarker::Item == marker ) {
+            if( !readMapItem( map ) || !read( marker ) ) {
+                return false;
+            }
         }
+        return SerializationMarker::End == marker;
+    }
+
+    IntegerEncoding m_integerEncoding = IntegerEncoding::Fixed;
+    Arena* m_arena = nullptr;
+}; // class BasicInput
+
+
+class InputBase : public BasicInput<InputBase> {
+public:
+    using UPtr = std::unique_ptr<InputBase>;
+
+    virtual ~InputBase() = default;
+
+    virtual SizeType read( ValuePtr data, const SizeType dataSize ) = 0;
+
+    using BasicInput::read;
+
+    virtual SizeType size() const {
+        return 0;
+    }
+
+    virtual bool reset( const SizeType offset ) {
         return false;
     }
+
+    /**
+     * @brief Skip dataSize bytes of a contiguous buffer and return where they start
+     *
+     * nullptr if fewer bytes are left or the stream has no buffer to point
+     * into, the views read from the stream rely on it.
+     */
+    virtual const ValueType* consume( const SizeType dataSize ) {
+        return nullptr;
+    }
 }; // class InputBase
 
 
+/**
+ * @brief InputBase over a non-virtual stream, for code taking an InputBase&
+ */
+template <typename Stream>
+class InputAdapter final : public InputBase {
+    Stream& m_stream;
+
+public:
+    explicit InputAdapter( Stream& stream )
+    : m_stream( stream ) {
+        setIntegerEncoding( stream.integerEncoding() );
+        setArena( stream.arena() );
+    }
+
+    SizeType read( ValuePtr data, const SizeType dataSize ) override {
+        return m_stream.read( data, dataSize );
+    }
+
+    using InputBase::read;
+
+    SizeType size() const override {
+        return m_stream.size();
+    }
+
+    bool reset( const SizeType offset ) override {
+        return m_stream.reset( offset );
+    }
+
+    const ValueType* consume( const SizeType dataSize ) override {
+        return m_stream.consume( dataSize );
+    }
+};
+
+
 class ArrayInputStream final : public InputBase {
     ValuePtr m_buf;
     SizeType m_bufsize;
@@ -241,6 +616,50 @@ public:
     SizeType size() const override;
 
     bool reset( const SizeType offset ) override;
+
+    const ValueType* consume( const SizeType dataSize ) override;
+};
+
+
+/**
+ * @brief Non-virtual counterpart of ArrayInputStream, its reads inline into the decoding
+ */
+class ArrayReader final : public BasicInput<ArrayReader> {
+    const ValueType *m_buf;
+    SizeType m_bufsize;
+    SizeType m_rpos = 0;
+
+public:
+    ArrayReader( const ValueType *buf, const SizeType bufSize )
+    : m_buf( buf )
+    , m_bufsize( bufSize ) {}
+
+    SizeType read( ValuePtr data, const SizeType dataSize ) {
+        const SizeType sizeToRead = std::min<SizeType>( dataSize, size() );
+        std::memcpy( data, m_buf + m_rpos, sizeToRead );
+        m_rpos += sizeToRead;
+        return sizeToRead;
+    }
+
+    using BasicInput::read;
+
+    SizeType size() const {
+        return m_bufsize - m_rpos;
+    }
+
+    bool reset( const SizeType offset ) {
+        m_rpos = offset;
+        return true;
+    }
+
+    const ValueType* consume( const SizeType dataSize ) {
+        if( dataSize > size() ) {
+            return nullptr;
+        }
+        const ValueType* data = m_buf + m_rpos;
+        m_rpos += dataSize;
+        return data;
+    }
 };
 
 
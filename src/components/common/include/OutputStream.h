@@ -1,10 +1,19 @@
 #pragma once
 
+#include "ArrayView.h"
+#include "Schema.h"
+#include "StreamTraits.h"
+#include "Varint.h"
+
+#include <algorithm>
 #include <cstdint>
 #include <type_traits>
 #include <string>
+#include <string_view>
 #include <cstring>
+#include <array>
 #include <list>
+#include <vector>
 #include <map>
 #include <unordered_map>
 #include <set>
@@ -12,82 +21,340 @@
 
 namespace streams {
 
-class OutputBase {
-    enum class SerializationMarker : std::uint8_t { Item, End };
+class OutputBase;
+
+template <typename Stream>
+class OutputAdapter;
+
+/**
+ * @brief Encoding of values, containers and messages on top of the byte writes of Derived
+ *
+ * Derived provides write( const ValueType*, SizeType ) and optionally
+ * writeBorrowed(), see OutputBase. OutputBase makes them virtual, a
+ * concrete stream like ArrayWriter has them inline and the encoding
+ * compiles down to plain stores. Objects encoding themselves to an
+ * OutputBase& get an OutputAdapter over a non-virtual stream.
+ */
+template <typename Derived>
+class BasicOutput {
+    enum class SerializationMarker : std::uint8_t { Item, End, Counted };
+
+    static constexpr std::size_t CHUNK_SIZE = 256;  // stack buffer of the bulk container writes
 
 public:
-    using UPtr = std::unique_ptr<OutputBase>;
     using SizeType = std::uint32_t;
     using ValueType = char;
 
-    virtual ~OutputBase() = default;
+    /**
+     * @brief Bytes that stay valid until the stream is sent, copied unless Derived borrows them
+     */
+    SizeType writeBorrowed( const ValueType *data, const SizeType size ) {
+        return self().write( data, size );
+    }
 
-    virtual SizeType write( const ValueType *data, const SizeType size ) = 0;
+    IntegerEncoding integerEncoding() const {
+        return m_integerEncoding;
+    }
 
-    virtual bool flush() = 0;
+    /**
+     * @brief Wire format of the integers written further, including item counts and string lengths
+     */
+    void setIntegerEncoding( const IntegerEncoding encoding ) {
+        m_integerEncoding = encoding;
+    }
+
+    ContainerFormat containerFormat() const {
+        return m_containerFormat;
+    }
+
+    /**
+     * @brief Wire format of the lists, sets and maps written further, ContainerFormat::Markers for readers of the first release
+     */
+    void setContainerFormat( const ContainerFormat format ) {
+        m_containerFormat = format;
+    }
 
     template <typename ValType, typename std::enable_if<std::is_integral<ValType>::value || std::is_floating_point<ValType>::value || std::is_enum<ValType>::value, int>::type = 0>
     inline bool write( const ValType& value ) {
-        return sizeof( ValType ) == write( reinterpret_cast<const ValueType *>( &value ), sizeof( ValType ) );
+        if constexpr( varint::IsWide<ValType>::value ) {
+            if( IntegerEncoding::Varint == m_integerEncoding ) {
+                return writeVarint( value );
+            }
+        }
+        return sizeof( ValType ) == self().write( reinterpret_cast<const ValueType *>( &value ), sizeof( ValType ) );
     }
 
-    inline bool write( const std::string& str ) {
+    /**
+     * @brief Write a LEB128 varint regardless of the stream encoding, lets a single field opt in
+     */
+    template <typename ValType>
+    bool writeVarint( const ValType& value ) {
+        static_assert( varint::IsEncodable<ValType>::value, "Only integers and enums are coded as varints" );
+        ValueType buffer[varint::maxBytes<ValType>()];
+        SizeType dataSize = 0;
+        std::uint64_t bits = varint::encode( value );
+        do {
+            const auto byte = static_cast<std::uint8_t>( bits & 0x7f );
+            bits >>= 7;
+            buffer[dataSize++] = static_cast<ValueType>( bits ? byte | 0x80 : byte );
+        } while( bits );
+        return dataSize == self().write( buffer, dataSize );
+    }
+
+    template <typename Traits, typename Alloc>
+    inline bool write( const std::basic_string<char, Traits, Alloc>& str ) {
+        const SizeType lenght = str.length();
+        return write( lenght ) && lenght == self().write( str.c_str(), lenght );
+    }
+
+    /**
+     * @brief Same wire format as a std::string, the characters are written borrowed
+     */
+    inline bool write( std::string_view str ) {
         const SizeType lenght = str.length();
-        return write( lenght ) && lenght == write( str.c_str(), lenght );
+        return write( lenght ) && lenght == self().writeBorrowed( str.data(), lenght );
+    }
+
+    /**
+     * @brief Same wire format as a vector, the values are written borrowed if they are raw coded
+     */
+    template <typename ValType>
+    bool write( const ArrayView<ValType>& view ) {
+        const SizeType itemsCount = view.size();
+        if( !write( itemsCount ) ) {
+            return false;
+        }
+        if( isRawCoded<ValType>() ) {
+            const SizeType dataSize = static_cast<SizeType>( itemsCount * sizeof( ValType ) );
+            return dataSize == self().writeBorrowed( view.data(), dataSize );
+        }
+        for( const ValType item : view ) {
+            if( !write( item ) ) {
+                return false;
+            }
+        }
+        return true;
     }
 
-    template <typename T>
-    bool write( const std::list<T>& list ) {
+    template <typename T, typename Alloc>
+    bool write( const std::list<T, Alloc>& list ) {
         return writeListLikeContainer( list );
     }
 
-    template <typename Key, typename Value>
-    bool write( const std::unordered_map<Key, Value>& map ) {
+    /**
+     * @brief Items count followed by the items, as InputBase::read() of a vector expects
+     */
+    template <typename ValType, typename Alloc>
+    bool write( const std::vector<ValType, Alloc>& vec ) {
+        const SizeType itemsCount = vec.size();
+        if( !write( itemsCount ) ) {
+            return false;
+        }
+        if constexpr( IsRawVectorItem<ValType>::value ) {
+            if( isRawCoded<ValType>() ) {
+                return writeItems( vec.data(), vec.size() );
+            }
+        }
+        for( const ValType& item : vec ) {
+            if( !write( item ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Fixed number of items, no count is serialized
+     */
+    template <typename ValType, std::size_t N>
+    bool write( const std::array<ValType, N>& items ) {
+        if constexpr( IsRawValue<ValType>::value ) {
+            if( isRawCoded<ValType>() ) {
+                return writeItems( items.data(), N );
+            }
+        }
+        for( const auto& item : items ) {
+            if( !write( item ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename Key, typename Value, typename Hash, typename KeyEqual, typename Alloc>
+    bool write( const std::unordered_map<Key, Value, Hash, KeyEqual, Alloc>& map ) {
         return writeMapLikeContainer( map );
     }
 
-    template <typename Key, typename Value>
-    bool write( const std::map<Key, Value>& map ) {
+    template <typename Key, typename Value, typename Compare, typename Alloc>
+    bool write( const std::map<Key, Value, Compare, Alloc>& map ) {
         return writeMapLikeContainer( map );
     }
 
-    template <typename Value>
-    bool write( const std::set<Value>& set ) {
+    template <typename Value, typename Compare, typename Alloc>
+    bool write( const std::set<Value, Compare, Alloc>& set ) {
         return writeListLikeContainer( set );
     }
 
+    /**
+     * @brief Fields of a schema, see Schema.h, or the write() member of the object
+     */
     template <typename T, typename std::enable_if<std::is_class<T>::value, int>::type = 0>
     inline bool write( const T& object ) {
-        return object.write( *this );
+        if constexpr( HasFields<T>::value ) {
+            return std::apply( [this, &object]( auto... fields ) { return ( write( object.*fields ) && ... ); }, T::fields() );
+        }
+        else {
+            if constexpr( std::is_base_of<OutputBase, Derived>::value ) {
+                return object.write( static_cast<OutputBase&>( self() ) );
+            }
+            else {
+                OutputAdapter<Derived> adapter( self() );
+                return object.write( adapter );
+            }
+        }
     }
 
+protected:
+    BasicOutput() = default;
+    ~BasicOutput() = default;
+
 private:
+    Derived& self() {
+        return static_cast<Derived&>( *this );
+    }
+
+    /**
+     * @brief Raw value written as its in-memory bytes by the stream encoding
+     */
+    template <typename ValType>
+    bool isRawCoded() const {
+        return !varint::IsWide<ValType>::value || IntegerEncoding::Fixed == m_integerEncoding;
+    }
+
+    template <typename ValType>
+    bool writeItems( const ValType* items, std::size_t itemsCount ) {
+        const SizeType dataSize = static_cast<SizeType>( itemsCount * sizeof( ValType ) );
+        return dataSize == self().write( reinterpret_cast<const ValueType *>( items ), dataSize );
+    }
+
     template <typename Container>
     bool writeListLikeContainer( const Container& list ) {
-        auto end = list.cend();
-        for( auto itr = list.cbegin(); itr != end; ++itr ) {
-            if( !write( SerializationMarker::Item ) ) {
-                return false;
+        if( ContainerFormat::Markers == m_containerFormat ) {
+            auto end = list.cend();
+            for( auto itr = list.cbegin(); itr != end; ++itr ) {
+                if( !write( SerializationMarker::Item ) ) {
+                    return false;
+                }
+                if( !write( *itr ) ) {
+                    return false;
+                }
+            }
+            return write( SerializationMarker::End );
+        }
+
+        const SizeType itemsCount = list.size();
+        if( !write( SerializationMarker::Counted ) || !write( itemsCount ) ) {
+            return false;
+        }
+        using Item = typename Container::value_type;
+        if constexpr( IsRawValue<Item>::value ) {
+            if( isRawCoded<Item>() ) {
+                // Nodes aren't contiguous, the values are gathered into chunks
+                constexpr SizeType CHUNK_ITEMS = CHUNK_SIZE / sizeof( Item ) ? CHUNK_SIZE / sizeof( Item ) : 1;
+                Item chunk[CHUNK_ITEMS];
+                SizeType chunkItems = 0;
+                for( const auto& item : list ) {
+                    chunk[chunkItems++] = item;
+                    if( CHUNK_ITEMS == chunkItems ) {
+                        if( !writeItems( chunk, chunkItems ) ) {
+                            return false;
+                        }
+                        chunkItems = 0;
+                    }
+                }
+                return writeItems( chunk, chunkItems );
             }
-            if( !write( *itr ) ) {
+        }
+        for( const auto& item : list ) {
+            if( !write( item ) ) {
                 return false;
             }
         }
-        return write( SerializationMarker::End );
+        return true;
     }
 
     template <typename Container>
     bool writeMapLikeContainer( const Container& map ) {
+        const bool isCounted = ContainerFormat::Counted == m_containerFormat;
+        const SizeType itemsCount = map.size();
+        if( isCounted && ( !write( SerializationMarker::Counted ) || !write( itemsCount ) ) ) {
+            return false;
+        }
         auto end = map.cend();
         for( auto itr = map.cbegin(); itr != end; ++itr ) {
-            if( !write( SerializationMarker::Item ) ) {
+            if( !isCounted && !write( SerializationMarker::Item ) ) {
                 return false;
             }
             if( !write( itr->first ) || !write( itr->second ) ) {
                 return false;
             }
         }
-        return write( SerializationMarker::End );
+        return isCounted || write( SerializationMarker::End );
+    }
+
+    IntegerEncoding m_integerEncoding = IntegerEncoding::Fixed;
+    ContainerFormat m_containerFormat = ContainerFormat::Counted;
+}; // class BasicOutput
+
+class OutputBase : public BasicOutput<OutputBase> {
+public:
+    using UPtr = std::unique_ptr<OutputBase>;
+
+    virtual ~OutputBase() = default;
+
+    virtual SizeType write( const ValueType *data, const SizeType size ) = 0;
+
+    using BasicOutput::write;
+
+    virtual bool flush() = 0;
+
+    /**
+     * @brief Write bytes that stay valid until the stream is sent, the default copies them
+     *
+     * SegmentedOutputStream references such bytes instead of copying them.
+     */
+    virtual SizeType writeBorrowed( const ValueType *data, const SizeType size ) {
+        return write( data, size );
+    }
+}; // class OutputBase
+
+/**
+ * @brief OutputBase over a non-virtual stream, for code taking an OutputBase&
+ */
+template <typename Stream>
+class OutputAdapter final : public OutputBase {
+    Stream& m_stream;
+
+public:
+    explicit OutputAdapter( Stream& stream )
+    : m_stream( stream ) {
+        setIntegerEncoding( stream.integerEncoding() );
+        setContainerFormat( stream.containerFormat() );
+    }
+
+    SizeType write( const ValueType *data, const SizeType dataSize ) override {
+        return m_stream.write( data, dataSize );
+    }
+
+    SizeType writeBorrowed( const ValueType *data, const SizeType dataSize ) override {
+        return m_stream.writeBorrowed( data, dataSize );
+    }
+
+    using OutputBase::write;
+
+    bool flush() override {
+        return m_stream.flush();
     }
 };
 
@@ -110,4 +377,106 @@ public:
     SizeType freeSpace() const;
 };
 
+/**
+ * @brief Non-virtual counterpart of ArrayOutputStream, its writes inline into the encoding
+ */
+class ArrayWriter final : public BasicOutput<ArrayWriter> {
+    ValueType *m_buf;
+    SizeType m_bufsize;
+    SizeType m_wpos = 0;
+
+public:
+    ArrayWriter( ValueType *buf, SizeType bufSize )
+    : m_buf( buf )
+    , m_bufsize( bufSize ) {}
+
+    SizeType write( const ValueType *data, const SizeType dataSize ) {
+        if( dataSize > freeSpace() ) {
+            return writePartial( data, dataSize );
+        }
+        std::memcpy( m_buf + m_wpos, data, dataSize );  // a single store once the size is a constant
+        m_wpos += dataSize;
+        return dataSize;
+    }
+
+    using BasicOutput::write;
+
+    bool flush() {
+        m_wpos = 0;
+        return true;
+    }
+
+    SizeType dataSize() const {
+        return m_wpos;
+    }
+
+    SizeType freeSpace() const {
+        return m_bufsize - m_wpos;
+    }
+
+private:
+    SizeType writePartial( const ValueType *data, const SizeType dataSize ) {
+        const SizeType sizeToWrite = freeSpace();
+        std::memcpy( m_buf + m_wpos, data, sizeToWrite );
+        m_wpos += sizeToWrite;
+        return sizeToWrite;
+    }
+};
+
+/**
+ * @brief Output stream recording a chain of segments for a vectored send, e.g. sendmsg()
+ *
+ * Bytes written with write() are copied into the inline buffer, adjacent
+ * writes share one segment. Bytes written with writeBorrowed(), e.g. the
+ * characters of a std::string_view, are referenced in place and must stay
+ * valid until the segments are sent; borrowed spans shorter than
+ * MIN_BORROWED_SIZE are copied, an iovec costs more than copying them.
+ * Segments and inline buffer are provided by the caller.
+ */
+class SegmentedOutputStream final : public OutputBase {
+public:
+    static constexpr SizeType MIN_BORROWED_SIZE = 32;
+
+    struct Segment {
+        const ValueType *data;
+        SizeType size;
+    };
+
+    SegmentedOutputStream( Segment *segments, SizeType maxSegments, ValueType *buf, SizeType bufSize );
+
+    SizeType write( const ValueType *data, const SizeType dataSize ) override;
+
+    SizeType writeBorrowed( const ValueType *data, const SizeType dataSize ) override;
+
+    using OutputBase::write;
+
+    /**
+     * @brief Drop all segments
+     */
+    bool flush() override;
+
+    const Segment *segments() const;
+
+    SizeType segmentsCount() const;
+
+    /**
+     * @brief Bytes of all segments
+     */
+    SizeType dataSize() const;
+
+    /**
+     * @brief Bytes copied into the inline buffer
+     */
+    SizeType copiedSize() const;
+
+private:
+    Segment *m_segments;
+    SizeType m_maxSegments;
+    SizeType m_segmentsCount = 0;
+    ValueType *m_buf;
+    SizeType m_bufsize;
+    SizeType m_wpos = 0;
+    SizeType m_dataSize = 0;
+};
+
 } // namespace streams
\ No newline at end of file
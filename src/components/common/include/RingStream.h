@@ -0,0 +1,188 @@
+#pragma once
+
+#include "InputStream.h"
+#include "OutputStream.h"
+
+#include <cstdint>
+
+namespace streams {
+
+/**
+ * @brief Circular byte buffer between a transport and the ring streams
+ *
+ * Bytes are appended at the tail and dropped at the head, offsets are
+ * relative to the head. The storage is provided by the caller. A transport
+ * may receive straight into the buffer with writeSpan() and produce(), and
+ * send straight from it with readSpan() and drop().
+ */
+class RingBuffer {
+public:
+    using SizeType = std::uint32_t;
+    using ValueType = char;
+    using ValuePtr = ValueType *;
+
+    RingBuffer( ValuePtr buf, SizeType bufSize );
+
+    SizeType capacity() const;
+
+    /**
+     * @brief Buffered bytes
+     */
+    SizeType size() const;
+
+    SizeType freeSpace() const;
+
+    /**
+     * @brief Append up to dataSize bytes, returns the number appended
+     */
+    SizeType write( const ValueType *data, SizeType dataSize );
+
+    /**
+     * @brief Copy up to dataSize bytes starting at offset, nothing is dropped
+     */
+    SizeType peek( SizeType offset, ValuePtr data, SizeType dataSize ) const;
+
+    /**
+     * @brief Overwrite buffered bytes starting at offset
+     */
+    bool poke( SizeType offset, const ValueType *data, SizeType dataSize );
+
+    /**
+     * @brief Drop up to dataSize bytes at the head
+     */
+    SizeType drop( SizeType dataSize );
+
+    /**
+     * @brief Drop the bytes past newSize at the tail
+     */
+    bool truncate( SizeType newSize );
+
+    /**
+     * @brief Buffered bytes starting at offset, nullptr if the dataSize bytes wrap around the end of the storage
+     */
+    const ValueType *data( SizeType offset, SizeType dataSize ) const;
+
+    /**
+     * @brief Rotate the storage in place so the buffered bytes start at its beginning and are contiguous
+     *
+     * Pointers returned by data() before are invalidated.
+     */
+    void compact();
+
+    /**
+     * @brief Contiguous free space at the tail, the bytes put there are appended by produce()
+     */
+    ValuePtr writeSpan( SizeType& spanSize );
+
+    void produce( SizeType dataSize );
+
+    /**
+     * @brief Contiguous buffered bytes at the head, release them with drop()
+     */
+    const ValueType *readSpan( SizeType& spanSize ) const;
+
+private:
+    SizeType index( SizeType offset ) const;
+
+    ValuePtr m_buf;
+    SizeType m_bufsize;
+    SizeType m_head = 0;
+    SizeType m_size = 0;
+};
+
+/**
+ * @brief Output stream appending to a RingBuffer
+ *
+ * beginFrame() and endFrame() enclose the bytes of a frame and prefix them
+ * with their SizeType length, the format RingInputStream::nextFrame()
+ * expects. A frame that doesn't fit is removed whole.
+ */
+class RingOutputStream final : public OutputBase {
+public:
+    explicit RingOutputStream( RingBuffer& ring );
+
+    SizeType write( const ValueType *data, const SizeType dataSize ) override;
+
+    using OutputBase::write;
+
+    /**
+     * @brief Nothing to do, the bytes stay in the ring until the transport drops them
+     */
+    bool flush() override;
+
+    bool beginFrame();
+
+    /**
+     * @brief Write the length of the frame, false and the frame is removed if a write of it failed
+     */
+    bool endFrame();
+
+private:
+    RingBuffer& m_ring;
+    SizeType m_frameStart = 0;
+    bool m_isInFrame = false;
+    bool m_isFrameFailed = false;
+};
+
+/**
+ * @brief Input stream decoding from a RingBuffer as the bytes arrive
+ *
+ * Reads advance a cursor, the bytes are dropped from the ring by commit()
+ * only, rollback() returns to the last commit. A decode that ran out of
+ * bytes is rolled back and retried once more bytes arrived.
+ *
+ * nextFrame() decodes length prefixed frames, see RingOutputStream. The
+ * length is parsed once and kept until the whole frame is buffered, then
+ * the stream is limited to the payload, which is made contiguous so views
+ * can point into it. Frames longer than the ring are skipped as they
+ * arrive and counted by skippedFrames().
+ */
+class RingInputStream final : public InputBase {
+public:
+    explicit RingInputStream( RingBuffer& ring );
+
+    SizeType read( ValuePtr data, const SizeType dataSize ) override;
+
+    using InputBase::read;
+
+    /**
+     * @brief Bytes left, up to the end of the current frame
+     */
+    SizeType size() const override;
+
+    /**
+     * @brief Move the cursor to offset from the last commit, or from the payload start inside a frame
+     */
+    bool reset( const SizeType offset ) override;
+
+    /**
+     * @brief nullptr if the bytes wrap around the end of the storage, never inside a frame
+     */
+    const ValueType* consume( const SizeType dataSize ) override;
+
+    /**
+     * @brief Drop the bytes read so far, the whole frame inside a frame
+     */
+    void commit();
+
+    void rollback();
+
+    /**
+     * @brief Drop the current frame and start the next one, false until all of its bytes are buffered
+     */
+    bool nextFrame();
+
+    std::uint32_t skippedFrames() const;
+
+private:
+    RingBuffer& m_ring;
+    SizeType m_rpos = 0;
+    SizeType m_payloadStart = 0;
+    SizeType m_frameEnd = 0;        // 0 outside a frame
+    SizeType m_pendingSize = 0;     // frame length parsed before its payload arrived
+    bool m_hasPendingSize = false;
+    SizeType m_skipSize = 0;        // bytes of an oversized frame still to drop
+    std::uint32_t m_skippedFrames = 0;
+};
+
+} // namespace streams
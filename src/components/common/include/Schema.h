@@ -0,0 +1,77 @@
+#pragma once
+
+#include "StreamTraits.h"
+
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+
+namespace streams {
+
+/**
+ * @brief Message schemas
+ *
+ * A message lists its fields in the order of the wire format:
+ *
+ *     struct Temperature {
+ *         std::uint64_t sensorId;
+ *         float value;
+ *
+ *         static constexpr auto fields() {
+ *             return std::make_tuple( &Temperature::sensorId, &Temperature::value );
+ *         }
+ *     };
+ *
+ * OutputBase::write() and InputBase::read() walk the same list, so the two
+ * can't disagree on the order, and EncodedSize gives the largest encoding
+ * at compile time. A schema takes precedence over read() / write() members.
+ */
+template <typename T, typename = void>
+struct HasFields : std::false_type {};
+
+template <typename T>
+struct HasFields<T, std::void_t<decltype( T::fields() )>> : std::true_type {};
+
+template <typename Member>
+struct MemberOf;
+
+template <typename Class, typename Field>
+struct MemberOf<Field Class::*> {
+    using Type = Field;
+};
+
+/**
+ * @brief Largest encoding of a value with IntegerEncoding::Fixed, MAX is 0 for unbounded types
+ */
+template <typename T, typename = void>
+struct EncodedSize {
+    static constexpr bool IS_BOUNDED = false;
+    static constexpr std::size_t MAX = 0;
+};
+
+template <typename T>
+struct EncodedSize<T, typename std::enable_if<IsRawValue<T>::value>::type> {
+    static constexpr bool IS_BOUNDED = true;
+    static constexpr std::size_t MAX = sizeof( T );
+};
+
+template <typename T, std::size_t N>
+struct EncodedSize<std::array<T, N>> {
+    static constexpr bool IS_BOUNDED = EncodedSize<T>::IS_BOUNDED;
+    static constexpr std::size_t MAX = IS_BOUNDED ? N * EncodedSize<T>::MAX : 0;
+};
+
+template <typename Fields>
+struct FieldsSize;
+
+template <typename... Members>
+struct FieldsSize<std::tuple<Members...>> {
+    static constexpr bool IS_BOUNDED = ( EncodedSize<typename MemberOf<Members>::Type>::IS_BOUNDED && ... );
+    static constexpr std::size_t MAX = IS_BOUNDED ? ( EncodedSize<typename MemberOf<Members>::Type>::MAX + ... + 0 ) : 0;
+};
+
+template <typename T>
+struct EncodedSize<T, typename std::enable_if<HasFields<T>::value>::type> : FieldsSize<decltype( T::fields() )> {};
+
+} // namespace streams
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+namespace streams {
+
+/**
+ * @brief Values serialized as their in-memory bytes
+ *
+ * A contiguous run of them is copied with a single read() or write() call.
+ */
+template <typename T>
+struct IsRawValue : std::integral_constant<bool, std::is_integral<T>::value || std::is_floating_point<T>::value || std::is_enum<T>::value> {};
+
+/**
+ * @brief Raw values stored contiguously by std::vector, std::vector<bool> packs its bits
+ */
+template <typename T>
+struct IsRawVectorItem : std::integral_constant<bool, IsRawValue<T>::value && !std::is_same<T, bool>::value> {};
+
+/**
+ * @brief Wire format of the lists, sets and maps written by OutputBase
+ *
+ * Markers - an Item byte before every element and a final End byte, the format of the first release
+ * Counted - a Counted byte, the SizeType elements count and the elements
+ *
+ * InputBase reads both, the first byte tells them apart.
+ */
+enum class ContainerFormat : std::uint8_t { Markers, Counted };
+
+} // namespace streams
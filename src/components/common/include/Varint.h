@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+namespace streams {
+
+/**
+ * @brief Wire format of the integers of a stream
+ *
+ * Fixed - native width and byte order, the default
+ * Varint - LEB128, signed values are zigzag mapped first, integers of one byte stay fixed
+ */
+enum class IntegerEncoding : std::uint8_t { Fixed, Varint };
+
+namespace varint {
+
+template <typename T, bool = std::is_enum<T>::value>
+struct IntegerOf {
+    using Type = T;
+};
+
+template <typename T>
+struct IntegerOf<T, true> {
+    using Type = typename std::underlying_type<T>::type;
+};
+
+/**
+ * @brief Integers and enums that may be coded as varints, bool stays a single byte
+ */
+template <typename T>
+struct IsEncodable : std::integral_constant<bool, ( std::is_integral<T>::value || std::is_enum<T>::value ) && !std::is_same<T, bool>::value> {};
+
+/**
+ * @brief Values coded as varints by a stream in IntegerEncoding::Varint
+ */
+template <typename T>
+struct IsWide : std::integral_constant<bool, IsEncodable<T>::value && ( sizeof( T ) > 1 )> {};
+
+template <typename T>
+constexpr unsigned maxBytes() {
+    return ( sizeof( T ) * 8 + 6 ) / 7;
+}
+
+/**
+ * @brief Unsigned bits of a value, zigzag mapped for signed types: 0, -1, 1, -2 -> 0, 1, 2, 3
+ */
+template <typename T>
+std::uint64_t encode( T value ) {
+    using Integer = typename IntegerOf<T>::Type;
+    using Unsigned = typename std::make_unsigned<Integer>::type;
+    const auto integer = static_cast<Integer>( value );
+    if constexpr( std::is_signed<Integer>::value ) {
+        const auto sign = static_cast<Unsigned>( integer < 0 ? ~Unsigned( 0 ) : 0 );
+        return static_cast<Unsigned>( static_cast<Unsigned>( integer ) << 1 ) ^ sign;
+    }
+    else {
+        return static_cast<Unsigned>( integer );
+    }
+}
+
+template <typename T>
+T decode( std::uint64_t bits ) {
+    using Integer = typename IntegerOf<T>::Type;
+    using Unsigned = typename std::make_unsigned<Integer>::type;
+    const auto value = static_cast<Unsigned>( bits );
+    if constexpr( std::is_signed<Integer>::value ) {
+        return static_cast<T>( static_cast<Integer>( static_cast<Unsigned>( value >> 1 ) ^ static_cast<Unsigned>( -static_cast<Unsigned>( value & 1 ) ) ) );
+    }
+    else {
+        return static_cast<T>( value );
+    }
+}
+
+} // namespace varint
+} // namespace streams
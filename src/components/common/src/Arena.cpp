@@ -0,0 +1,75 @@
+#include "../include/Arena.h"
+
+#include <algorithm>
+#include <new>
+
+namespace streams {
+
+
+Arena::Arena( void *buf, SizeType bufSize )
+: m_buf( static_cast<char *>( buf ) )
+, m_bufsize( bufSize ) {}
+
+
+Arena::~Arena() {
+    release();
+}
+
+
+void *Arena::allocate( std::size_t size, std::size_t alignment ) {
+    const auto base = reinterpret_cast<std::uintptr_t>( m_buf );
+    const auto start = ( base + m_used + alignment - 1 ) & ~static_cast<std::uintptr_t>( alignment - 1 );
+    const auto offset = start - base;
+    if( !m_overflow && offset <= m_bufsize && size <= m_bufsize - offset ) {
+        m_used = static_cast<SizeType>( offset + size );
+        m_highWater = std::max( m_highWater, m_used );
+        return m_buf + offset;
+    }
+
+    // Over budget, the header keeps the payload aligned for any fundamental type
+    constexpr std::size_t HEADER_SIZE = alignof( std::max_align_t );
+    auto block = static_cast<Overflow *>( ::operator new( HEADER_SIZE + size ) );
+    block->next = m_overflow;
+    m_overflow = block;
+    return reinterpret_cast<char *>( block ) + HEADER_SIZE;
+}
+
+
+void Arena::deallocate( void *ptr, std::size_t size ) {
+    if( static_cast<char *>( ptr ) + size == m_buf + m_used ) {
+        m_used -= static_cast<SizeType>( size );
+    }
+}
+
+
+void Arena::release() {
+    while( m_overflow ) {
+        auto next = m_overflow->next;
+        ::operator delete( m_overflow );
+        m_overflow = next;
+    }
+    m_used = 0;
+}
+
+
+bool Arena::isExhausted() const {
+    return m_overflow;
+}
+
+
+Arena::SizeType Arena::capacity() const {
+    return m_bufsize;
+}
+
+
+Arena::SizeType Arena::used() const {
+    return m_used;
+}
+
+
+Arena::SizeType Arena::highWater() const {
+    return m_highWater;
+}
+
+
+} // namespace streams
@@ -0,0 +1,65 @@
+#include "../include/Crc.h"
+
+#include <array>
+
+namespace crc {
+
+namespace {
+
+/**
+ * @brief Byte table of a reflected CRC, built at compile time
+ */
+template <typename T, T POLYNOMIAL>
+constexpr std::array<T, 256> makeTable() {
+    std::array<T, 256> table = {};
+    for( unsigned byte = 0; byte < 256; ++byte ) {
+        T crc = static_cast<T>( byte );
+        for( int bit = 0; bit < 8; ++bit ) {
+            crc = static_cast<T>( crc & 1 ? ( crc >> 1 ) ^ POLYNOMIAL : crc >> 1 );
+        }
+        table[byte] = crc;
+    }
+    return table;
+}
+
+// 32 bit entries for both, the ESP8266 reads flash mapped constants with 32 bit loads only
+constexpr auto CRC16_TABLE = makeTable<std::uint32_t, 0xA001>();
+constexpr auto CRC32_TABLE = makeTable<std::uint32_t, 0xEDB88320>();
+
+constexpr std::uint32_t checkValue( const std::array<std::uint32_t, 256>& table, std::uint32_t crc ) {
+    const char digits[] = "123456789";
+    for( int i = 0; i < 9; ++i ) {
+        crc = table[( crc ^ static_cast<std::uint8_t>( digits[i] ) ) & 0xff] ^ ( crc >> 8 );
+    }
+    return crc;
+}
+
+static_assert( 0xBB3D == checkValue( CRC16_TABLE, 0 ), "CRC-16/ARC check value" );
+static_assert( 0xCBF43926 == ( checkValue( CRC32_TABLE, 0xFFFFFFFF ) ^ 0xFFFFFFFF ), "CRC-32 check value" );
+
+template <typename ValueType>
+ValueType updateReflected( const std::array<std::uint32_t, 256>& table, ValueType crc, const void *data, std::size_t dataSize ) {
+    auto bytes = static_cast<const std::uint8_t *>( data );
+    std::uint32_t value = crc;
+    while( dataSize-- ) {
+        value = table[( value ^ *bytes++ ) & 0xff] ^ ( value >> 8 );
+    }
+    return static_cast<ValueType>( value );
+}
+
+} // namespace
+
+constexpr Crc16::ValueType Crc16::INIT;
+constexpr Crc16::ValueType Crc16::XOR_OUT;
+constexpr Crc32::ValueType Crc32::INIT;
+constexpr Crc32::ValueType Crc32::XOR_OUT;
+
+Crc16::ValueType Crc16::update( ValueType crc, const void *data, std::size_t dataSize ) {
+    return updateReflected( CRC16_TABLE, crc, data, dataSize );
+}
+
+Crc32::ValueType Crc32::update( ValueType crc, const void *data, std::size_t dataSize ) {
+    return updateReflected( CRC32_TABLE, crc, data, dataSize );
+}
+
+} // namespace crc
@@ -26,4 +26,14 @@ bool ArrayInputStream::reset( const SizeType offset ) {
     return true;
 }
 
+
+const ArrayInputStream::ValueType* ArrayInputStream::consume( const SizeType dataSize ) {
+    if( dataSize > size() ) {
+        return nullptr;
+    }
+    const ValueType* data = m_buf + m_rpos;
+    m_rpos += dataSize;
+    return data;
+}
+
 } // namespace streams
\ No newline at end of file
@@ -32,4 +32,84 @@ ArrayOutputStream::SizeType ArrayOutputStream::freeSpace() const {
 }
 
 
+constexpr SegmentedOutputStream::SizeType SegmentedOutputStream::MIN_BORROWED_SIZE;
+
+
+SegmentedOutputStream::SegmentedOutputStream( Segment *segments, SizeType maxSegments, ValueType *buf, SizeType bufSize )
+: m_segments( segments )
+, m_maxSegments( maxSegments )
+, m_buf( buf )
+, m_bufsize( bufSize ) {}
+
+
+SegmentedOutputStream::SizeType SegmentedOutputStream::write( const ValueType *data, const SizeType dataSize ) {
+    const SizeType sizeToWrite = std::min<SizeType>( dataSize, m_bufsize - m_wpos );
+    if( !sizeToWrite ) {
+        return 0;
+    }
+
+    Segment *last = m_segmentsCount ? &m_segments[m_segmentsCount - 1] : nullptr;
+    if( !last || last->data + last->size != m_buf + m_wpos ) {
+        if( m_segmentsCount == m_maxSegments ) {
+            return 0;
+        }
+        last = &m_segments[m_segmentsCount++];
+        *last = Segment{ m_buf + m_wpos, 0 };
+    }
+    std::memcpy( m_buf + m_wpos, data, sizeToWrite );
+    m_wpos += sizeToWrite;
+    last->size += sizeToWrite;
+    m_dataSize += sizeToWrite;
+    return sizeToWrite;
+}
+
+
+SegmentedOutputStream::SizeType SegmentedOutputStream::writeBorrowed( const ValueType *data, const SizeType dataSize ) {
+    if( dataSize < MIN_BORROWED_SIZE ) {
+        return write( data, dataSize );
+    }
+
+    Segment *last = m_segmentsCount ? &m_segments[m_segmentsCount - 1] : nullptr;
+    if( last && last->data + last->size == data ) {
+        last->size += dataSize;  // continues the previous borrowed span
+    }
+    else if( m_segmentsCount < m_maxSegments ) {
+        m_segments[m_segmentsCount++] = Segment{ data, dataSize };
+    }
+    else {
+        return 0;
+    }
+    m_dataSize += dataSize;
+    return dataSize;
+}
+
+
+bool SegmentedOutputStream::flush() {
+    m_segmentsCount = 0;
+    m_wpos = 0;
+    m_dataSize = 0;
+    return true;
+}
+
+
+const SegmentedOutputStream::Segment *SegmentedOutputStream::segments() const {
+    return m_segments;
+}
+
+
+SegmentedOutputStream::SizeType SegmentedOutputStream::segmentsCount() const {
+    return m_segmentsCount;
+}
+
+
+SegmentedOutputStream::SizeType SegmentedOutputStream::dataSize() const {
+    return m_dataSize;
+}
+
+
+SegmentedOutputStream::SizeType SegmentedOutputStream::copiedSize() const {
+    return m_wpos;
+}
+
+
 } // namespace streams
\ No newline at end of file
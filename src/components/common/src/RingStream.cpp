@@ -0,0 +1,287 @@
+#include "../include/RingStream.h"
+
+#include <algorithm>
+
+namespace streams {
+
+
+RingBuffer::RingBuffer( ValuePtr buf, SizeType bufSize )
+: m_buf( buf )
+, m_bufsize( bufSize ) {}
+
+
+RingBuffer::SizeType RingBuffer::capacity() const {
+    return m_bufsize;
+}
+
+
+RingBuffer::SizeType RingBuffer::size() const {
+    return m_size;
+}
+
+
+RingBuffer::SizeType RingBuffer::freeSpace() const {
+    return m_bufsize - m_size;
+}
+
+
+RingBuffer::SizeType RingBuffer::index( SizeType offset ) const {
+    const SizeType position = m_head + offset;
+    return position >= m_bufsize ? position - m_bufsize : position;
+}
+
+
+RingBuffer::SizeType RingBuffer::write( const ValueType *data, SizeType dataSize ) {
+    const SizeType sizeToWrite = std::min<SizeType>( dataSize, freeSpace() );
+    const SizeType tail = index( m_size );
+    const SizeType firstPart = std::min<SizeType>( sizeToWrite, m_bufsize - tail );
+    std::memcpy( m_buf + tail, data, firstPart );
+    std::memcpy( m_buf, data + firstPart, sizeToWrite - firstPart );
+    m_size += sizeToWrite;
+    return sizeToWrite;
+}
+
+
+RingBuffer::SizeType RingBuffer::peek( SizeType offset, ValuePtr data, SizeType dataSize ) const {
+    if( offset > m_size ) {
+        return 0;
+    }
+    const SizeType sizeToRead = std::min<SizeType>( dataSize, m_size - offset );
+    const SizeType start = index( offset );
+    const SizeType firstPart = std::min<SizeType>( sizeToRead, m_bufsize - start );
+    std::memcpy( data, m_buf + start, firstPart );
+    std::memcpy( data + firstPart, m_buf, sizeToRead - firstPart );
+    return sizeToRead;
+}
+
+
+bool RingBuffer::poke( SizeType offset, const ValueType *data, SizeType dataSize ) {
+    if( offset > m_size || dataSize > m_size - offset ) {
+        return false;
+    }
+    const SizeType start = index( offset );
+    const SizeType firstPart = std::min<SizeType>( dataSize, m_bufsize - start );
+    std::memcpy( m_buf + start, data, firstPart );
+    std::memcpy( m_buf, data + firstPart, dataSize - firstPart );
+    return true;
+}
+
+
+RingBuffer::SizeType RingBuffer::drop( SizeType dataSize ) {
+    const SizeType sizeToDrop = std::min<SizeType>( dataSize, m_size );
+    m_size -= sizeToDrop;
+    m_head = m_size ? index( sizeToDrop ) : 0;  // an empty ring starts over, keeps the next bytes contiguous
+    return sizeToDrop;
+}
+
+
+bool RingBuffer::truncate( SizeType newSize ) {
+    if( newSize > m_size ) {
+        return false;
+    }
+    m_size = newSize;
+    if( !m_size ) {
+        m_head = 0;
+    }
+    return true;
+}
+
+
+const RingBuffer::ValueType *RingBuffer::data( SizeType offset, SizeType dataSize ) const {
+    if( offset > m_size || dataSize > m_size - offset ) {
+        return nullptr;
+    }
+    const SizeType start = index( offset );
+    return dataSize <= m_bufsize - start ? m_buf + start : nullptr;
+}
+
+
+void RingBuffer::compact() {
+    if( !m_head ) {
+        return;
+    }
+    if( m_head + m_size <= m_bufsize ) {
+        std::memmove( m_buf, m_buf + m_head, m_size );
+    }
+    else {
+        std::rotate( m_buf, m_buf + m_head, m_buf + m_bufsize );
+    }
+    m_head = 0;
+}
+
+
+RingBuffer::ValuePtr RingBuffer::writeSpan( SizeType& spanSize ) {
+    const SizeType tail = index( m_size );
+    if( m_size == m_bufsize ) {
+        spanSize = 0;
+    }
+    else {
+        spanSize = tail < m_head ? m_head - tail : m_bufsize - tail;
+    }
+    return m_buf + tail;
+}
+
+
+void RingBuffer::produce( SizeType dataSize ) {
+    m_size += std::min<SizeType>( dataSize, freeSpace() );
+}
+
+
+const RingBuffer::ValueType *RingBuffer::readSpan( SizeType& spanSize ) const {
+    spanSize = std::min<SizeType>( m_size, m_bufsize - m_head );
+    return m_buf + m_head;
+}
+
+
+RingOutputStream::RingOutputStream( RingBuffer& ring )
+: m_ring( ring ) {}
+
+
+RingOutputStream::SizeType RingOutputStream::write( const ValueType *data, const SizeType dataSize ) {
+    if( m_isFrameFailed ) {
+        return 0;
+    }
+    const SizeType written = m_ring.write( data, dataSize );
+    if( m_isInFrame && written != dataSize ) {
+        m_isFrameFailed = true;
+    }
+    return written;
+}
+
+
+bool RingOutputStream::flush() {
+    return true;
+}
+
+
+bool RingOutputStream::beginFrame() {
+    if( m_isInFrame ) {
+        return false;
+    }
+    const SizeType frameSize = 0;  // written by endFrame()
+    m_frameStart = m_ring.size();
+    if( sizeof( frameSize ) != m_ring.write( reinterpret_cast<const ValueType *>( &frameSize ), sizeof( frameSize ) ) ) {
+        m_ring.truncate( m_frameStart );
+        return false;
+    }
+    m_isInFrame = true;
+    m_isFrameFailed = false;
+    return true;
+}
+
+
+bool RingOutputStream::endFrame() {
+    if( !m_isInFrame ) {
+        return false;
+    }
+    m_isInFrame = false;
+    if( m_isFrameFailed ) {
+        m_isFrameFailed = false;
+        m_ring.truncate( m_frameStart );
+        return false;
+    }
+    const SizeType frameSize = m_ring.size() - m_frameStart - sizeof( SizeType );
+    return m_ring.poke( m_frameStart, reinterpret_cast<const ValueType *>( &frameSize ), sizeof( frameSize ) );
+}
+
+
+RingInputStream::RingInputStream( RingBuffer& ring )
+: m_ring( ring ) {}
+
+
+RingInputStream::SizeType RingInputStream::read( ValuePtr data, const SizeType dataSize ) {
+    const SizeType sizeToRead = m_ring.peek( m_rpos, data, std::min<SizeType>( dataSize, size() ) );
+    m_rpos += sizeToRead;
+    return sizeToRead;
+}
+
+
+RingInputStream::SizeType RingInputStream::size() const {
+    return ( m_frameEnd ? m_frameEnd : m_ring.size() ) - m_rpos;
+}
+
+
+bool RingInputStream::reset( const SizeType offset ) {
+    const SizeType position = m_payloadStart + offset;
+    if( position > ( m_frameEnd ? m_frameEnd : m_ring.size() ) ) {
+        return false;
+    }
+    m_rpos = position;
+    return true;
+}
+
+
+const RingInputStream::ValueType* RingInputStream::consume( const SizeType dataSize ) {
+    if( dataSize > size() ) {
+        return nullptr;
+    }
+    auto data = m_ring.data( m_rpos, dataSize );
+    if( data ) {
+        m_rpos += dataSize;
+    }
+    return data;
+}
+
+
+void RingInputStream::commit() {
+    m_ring.drop( m_frameEnd ? m_frameEnd : m_rpos );
+    m_rpos = 0;
+    m_payloadStart = 0;
+    m_frameEnd = 0;
+}
+
+
+void RingInputStream::rollback() {
+    m_rpos = m_payloadStart;
+}
+
+
+bool RingInputStream::nextFrame() {
+    if( m_frameEnd ) {
+        commit();
+    }
+    m_rpos = 0;
+
+    while( true ) {
+        if( m_skipSize ) {
+            m_skipSize -= m_ring.drop( m_skipSize );
+            if( m_skipSize ) {
+                return false;
+            }
+        }
+        if( !m_hasPendingSize ) {
+            if( sizeof( m_pendingSize ) != m_ring.peek( 0, reinterpret_cast<ValuePtr>( &m_pendingSize ), sizeof( m_pendingSize ) ) ) {
+                return false;
+            }
+            m_hasPendingSize = true;
+        }
+        if( m_pendingSize <= m_ring.capacity() - sizeof( SizeType ) ) {
+            break;
+        }
+        // Never fits, the frame is dropped as it arrives
+        m_ring.drop( sizeof( SizeType ) );
+        m_skipSize = m_pendingSize;
+        m_hasPendingSize = false;
+        ++m_skippedFrames;
+    }
+
+    const SizeType frameSize = sizeof( SizeType ) + m_pendingSize;
+    if( m_ring.size() < frameSize ) {
+        return false;
+    }
+    if( !m_ring.data( 0, frameSize ) ) {
+        m_ring.compact();
+    }
+    m_hasPendingSize = false;
+    m_payloadStart = sizeof( SizeType );
+    m_rpos = m_payloadStart;
+    m_frameEnd = frameSize;
+    return true;
+}
+
+
+std::uint32_t RingInputStream::skippedFrames() const {
+    return m_skippedFrames;
+}
+
+} // namespace streams
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Bus.h"
+#include "Messages.h"
+
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <functional>
+
+namespace udp_bridge {
+
+/**
+ * @brief Forwards listed commands of selected bus groups to other nodes and back
+ *
+ * The bridge joins the bridged groups, serializes the commands it receives
+ * into messages::BusBatch datagrams and injects the commands of remote
+ * batches into the local groups. Loops are prevented twice: injected
+ * commands skip the bridge's own mailbox, see DeliveryPolicy::excludingSender(),
+ * and a batch carrying the node's own ID is ignored.
+ *
+ * bridge() is called before poll() and inject() run, they may run on
+ * different tasks. Remote commands are injected with Priority::Normal.
+ */
+class BusBridge : public bus::IBusClient {
+public:
+    static constexpr std::size_t MAX_TOPICS = 8;
+
+    using SendFunction = std::function<bool( const char* data, int len )>;
+
+    struct Stats {
+        std::uint32_t forwarded = 0;  // local commands written into batches
+        std::uint32_t datagrams = 0;
+        std::uint32_t injected = 0;   // remote commands delivered to every member of the local group
+        std::uint32_t refused = 0;    // remote commands some local member didn't get, see bus::SendResult
+        std::uint32_t dropped = 0;    // commands not listed in command::Variant, malformed or unknown entries
+    };
+
+    /**
+     * @param send - datagram transport, e.g. udp_srv::sendData
+     */
+    BusBridge( bus::Bus& bus, std::uint32_t nodeId, SendFunction send, bus::DeliveryPolicy injectPolicy = bus::DeliveryPolicy() );
+
+    /**
+     * @brief Forward the group to the other nodes and accept it from them
+     */
+    bool bridge( bus::TopicId topic );
+
+    /**
+     * @brief Receive local commands for up to waitTime ticks and send them as one or more batches
+     */
+    void poll( TickType_t waitTime );
+
+    /**
+     * @brief Send the commands of a remote batch to the local groups
+     *
+     * The stream starts at the BusBatch header, see messages::Callbacks::onBusBatch.
+     */
+    void inject( messages::InputStreamType& stream );
+
+    Stats stats() const;
+
+protected:
+    void receive( const bus::BusAddr from, const bus::BusAddr to, const bus::IBusCommand& msg ) override;
+    void receive( const bus::BusAddr from, const bus::BusAddr to, const bus::command::Variant& msg ) override;
+
+private:
+    struct Topic {
+        bus::TopicId id;
+        bus::BusAddr addr = bus::BusAddrInvalid;
+    };
+
+    const Topic* findTopic( bus::BusAddr addr ) const;
+    const Topic* findTopic( bus::TopicId id ) const;
+
+    void flush();
+
+    bus::Bus& m_localBus;
+    const std::uint32_t m_nodeId;
+    SendFunction m_send;
+    bus::DeliveryPolicy m_injectPolicy;
+
+    std::array<Topic, MAX_TOPICS> m_topics;
+    std::size_t m_topicsCount = 0;
+
+    messages::BufferType m_batch;
+    messages::BufferType m_entry;
+    std::size_t m_batchSize = 0;
+    std::size_t m_batchEntries = 0;
+
+    std::atomic<std::uint32_t> m_forwarded{ 0 };
+    std::atomic<std::uint32_t> m_datagrams{ 0 };
+    std::atomic<std::uint32_t> m_injected{ 0 };
+    std::atomic<std::uint32_t> m_refused{ 0 };
+    std::atomic<std::uint32_t> m_dropped{ 0 };
+};
+
+}  // namespace udp_bridge
@@ -5,6 +5,7 @@
 
 #include <cstdint> 
 #include <array>
+#include <tuple>
 #include <iostream>
 #include <functional>
 
@@ -21,12 +22,8 @@ struct Discovery {
     
     std::uint32_t devId;
 
-    inline bool write( OutputStreamType& stream ) const {
-        return stream.write( devId );
-    }
-
-    inline bool read( InputStreamType& stream ) {
-        return stream.read( devId );
+    static constexpr auto fields() {
+        return std::make_tuple( &Discovery::devId );
     }
 };
 
@@ -36,18 +33,50 @@ struct Temperature {
     std::uint64_t sensorId;
     float value;
 
-    inline bool write( OutputStreamType& stream ) const {
-        return stream.write( sensorId ) && stream.write( value );
+    static constexpr auto fields() {
+        return std::make_tuple( &Temperature::sensorId, &Temperature::value );
     }
+};
+
+/**
+ * @brief Header of bus commands forwarded by udp_bridge::BusBridge
+ *
+ * Entries follow the header up to the end of the datagram, an entry is the
+ * std::uint32_t TopicId of the group, the std::uint8_t index of the command
+ * in bus::command::Variant and the fields written by the command.
+ */
+struct BusBatch {
+    static const MsgIdType ID = 0x5c2a91e7;
+
+    std::uint32_t origin;  // node ID of the sender, a node ignores its own batches
 
-    inline bool read( InputStreamType& stream ) {
-        return stream.read( sensorId ) && stream.read( value );
+    static constexpr auto fields() {
+        return std::make_tuple( &BusBatch::origin );
     }
 };
 
+/**
+ * @brief Largest datagram of a message, ID included, see streams::EncodedSize
+ */
+template <typename Msg>
+constexpr std::size_t maxMessageSize() {
+    static_assert( streams::EncodedSize<Msg>::IS_BOUNDED, "message has fields of unbounded size" );
+    return sizeof( MsgIdType ) + streams::EncodedSize<Msg>::MAX;
+}
+
+/**
+ * @brief Exactly sized buffer for create()
+ */
+template <typename Msg>
+using MsgBufferType = std::array<char, maxMessageSize<Msg>()>;
+
+static_assert( maxMessageSize<Discovery>() == 8, "Discovery wire format changed" );
+static_assert( maxMessageSize<Temperature>() == 16, "Temperature wire format changed" );
+static_assert( maxMessageSize<BusBatch>() == 8, "BusBatch wire format changed" );
+
 template <typename Msg, typename Buffer = BufferType>
 inline auto create(Buffer &buffer, const Msg &msg) {
-    streams::ArrayOutputStream ostream(buffer.data(), buffer.max_size());
+    streams::ArrayWriter ostream(buffer.data(), buffer.max_size());
     const MsgIdType id = msg.ID;
     bool isSuccess = ostream.write(id) && ostream.write(msg);
     return isSuccess ? ostream.dataSize() : 0;
@@ -56,6 +85,7 @@ inline auto create(Buffer &buffer, const Msg &msg) {
 struct Callbacks {
     std::function<void(Discovery &)> onDiscovery;
     std::function<void(Temperature &)> onTemperature;
+    std::function<void(InputStreamType &)> onBusBatch;  // stream starts at the BusBatch header
 };
 
 
@@ -67,6 +97,8 @@ void setCallback(std::function<void(Discovery &)> callback);
 
 void setCallback(std::function<void(Temperature &)> callback);
 
+void setCallback(std::function<void(InputStreamType &)> callback);
+
 bool parse(InputStreamType& stream);
 
 } // namespace messages
\ No newline at end of file
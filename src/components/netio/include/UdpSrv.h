@@ -1,5 +1,7 @@
 #pragma once
 
+#include "OutputStream.h"
+
 #include <string>
 
 #include <lwip/inet.h>
@@ -12,6 +14,11 @@ void run();
 
 bool sendData(const char* data, int len);
 
+/**
+ * @brief Send the segments of the stream as one datagram with sendmsg(), without flattening them
+ */
+bool sendData(const streams::SegmentedOutputStream &datagram);
+
 std::string toString(const in_addr &ip4addr); 
 
 } // namespace udp_srv
\ No newline at end of file
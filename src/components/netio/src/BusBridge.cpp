@@ -0,0 +1,167 @@
+#include "../include/BusBridge.h"
+
+#include "InputStream.h"
+#include "OutputStream.h"
+
+#include <cstring>
+#include <utility>
+#include <variant>
+
+namespace udp_bridge {
+
+constexpr std::size_t BusBridge::MAX_TOPICS;
+
+namespace {
+
+template <std::size_t I = 0>
+bool readCommand( messages::InputStreamType& stream, std::uint8_t index, bus::command::Variant& command ) {
+    if constexpr( I < std::variant_size<bus::command::Variant>::value ) {
+        if( index == I ) {
+            return stream.read( command.emplace<I>() );
+        }
+        return readCommand<I + 1>( stream, index, command );
+    }
+    else {
+        return false;
+    }
+}
+
+}  // namespace
+
+BusBridge::BusBridge( bus::Bus& bus, std::uint32_t nodeId, SendFunction send, bus::DeliveryPolicy injectPolicy )
+: IBusClient( bus )
+, m_localBus( bus )
+, m_nodeId( nodeId )
+, m_send( std::move( send ) )
+, m_injectPolicy( injectPolicy ) {}
+
+bool BusBridge::bridge( bus::TopicId topic ) {
+    if( findTopic( topic ) ) {
+        return true;
+    }
+    if( m_topicsCount == MAX_TOPICS || !initialize() || !m_localBus.join( topic, *this ) ) {
+        return false;
+    }
+
+    m_topics[m_topicsCount++] = Topic{ topic, m_localBus.resolve( topic ) };
+    return true;
+}
+
+const BusBridge::Topic* BusBridge::findTopic( bus::BusAddr addr ) const {
+    for( std::size_t i = 0; i < m_topicsCount; ++i ) {
+        if( m_topics[i].addr == addr ) {
+            return &m_topics[i];
+        }
+    }
+    return nullptr;
+}
+
+const BusBridge::Topic* BusBridge::findTopic( bus::TopicId id ) const {
+    for( std::size_t i = 0; i < m_topicsCount; ++i ) {
+        if( m_topics[i].id == id ) {
+            return &m_topics[i];
+        }
+    }
+    return nullptr;
+}
+
+void BusBridge::poll( TickType_t waitTime ) {
+    drain( bus::Mailbox::LENGTH, waitTime );
+    flush();
+}
+
+void BusBridge::receive( const bus::BusAddr from, const bus::BusAddr to, const bus::IBusCommand& msg ) {
+    m_dropped.fetch_add( 1, std::memory_order_relaxed );  // no wire format for unlisted commands
+}
+
+void BusBridge::receive( const bus::BusAddr from, const bus::BusAddr to, const bus::command::Variant& msg ) {
+    auto topic = findTopic( to );
+    if( from == addr() || !topic ) {
+        return;  // not a bridged group, or a command the bridge sent to a group without excluding itself
+    }
+
+    streams::ArrayOutputStream entry( m_entry.data(), m_entry.max_size() );
+    const auto index = static_cast<std::uint8_t>( msg.index() );
+    const bool isWritten = entry.write( topic->id.value ) && entry.write( index ) &&
+                           std::visit( [&entry]( const auto& command ) { return entry.write( command ); }, msg );
+    if( !isWritten ) {
+        m_dropped.fetch_add( 1, std::memory_order_relaxed );
+        return;
+    }
+
+    if( m_batchSize + entry.dataSize() > m_batch.max_size() ) {
+        flush();
+    }
+    if( !m_batchSize ) {
+        streams::ArrayOutputStream header( m_batch.data(), m_batch.max_size() );
+        const messages::MsgIdType id = messages::BusBatch::ID;
+        if( !header.write( id ) || !header.write( messages::BusBatch{ m_nodeId } ) ) {
+            return;
+        }
+        m_batchSize = header.dataSize();
+    }
+    std::memcpy( m_batch.data() + m_batchSize, m_entry.data(), entry.dataSize() );
+    m_batchSize += entry.dataSize();
+    ++m_batchEntries;
+}
+
+void BusBridge::flush() {
+    if( !m_batchEntries ) {
+        return;
+    }
+
+    if( m_send && m_send( m_batch.data(), static_cast<int>( m_batchSize ) ) ) {
+        m_forwarded.fetch_add( m_batchEntries, std::memory_order_relaxed );
+        m_datagrams.fetch_add( 1, std::memory_order_relaxed );
+    }
+    else {
+        m_dropped.fetch_add( m_batchEntries, std::memory_order_relaxed );
+    }
+    m_batchSize = 0;
+    m_batchEntries = 0;
+}
+
+void BusBridge::inject( messages::InputStreamType& stream ) {
+    messages::BusBatch batch;
+    if( !stream.read( batch ) || batch.origin == m_nodeId ) {
+        return;  // own batch sent back
+    }
+
+    std::uint32_t topicId = 0;
+    std::uint8_t index = 0;
+    bus::command::Variant command;
+    while( stream.size() ) {
+        if( !stream.read( topicId ) || !stream.read( index ) || !readCommand( stream, index, command ) ) {
+            m_dropped.fetch_add( 1, std::memory_order_relaxed );
+            return;  // the rest of the datagram can't be parsed
+        }
+
+        auto topic = findTopic( bus::TopicId{ topicId } );
+        if( !topic ) {
+            m_dropped.fetch_add( 1, std::memory_order_relaxed );
+            continue;
+        }
+        // The bridge is a member of the group, it must not queue the command for itself
+        const auto result = std::visit( [this, topic]( auto& cmd ) {
+            return send( topic->addr, std::move( cmd ), bus::Priority::Normal, m_injectPolicy.excludingSender() );
+        }, command );
+        if( bus::SendResult::Delivered == result ) {
+            m_injected.fetch_add( 1, std::memory_order_relaxed );
+        }
+        else if( bus::SendResult::Unresolved != result ) {
+            m_refused.fetch_add( 1, std::memory_order_relaxed );  // no local member is no refusal
+        }
+    }
+}
+
+BusBridge::Stats BusBridge::stats() const {
+    Stats result;
+    result.forwarded = m_forwarded.load( std::memory_order_relaxed );
+    result.datagrams = m_datagrams.load( std::memory_order_relaxed );
+    result.injected = m_injected.load( std::memory_order_relaxed );
+    result.refused = m_refused.load( std::memory_order_relaxed );
+    result.dropped = m_dropped.load( std::memory_order_relaxed );
+    return result;
+}
+
+}  // namespace udp_bridge
@@ -30,6 +30,10 @@ void setCallback(std::function<void(Temperature &)> callback) {
     g_callbacks.onTemperature = callback;
 }
 
+void setCallback(std::function<void(InputStreamType &)> callback) {
+    g_callbacks.onBusBatch = callback;
+}
+
 bool parse(InputStreamType& stream) {
     return false;
 }
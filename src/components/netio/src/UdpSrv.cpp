@@ -18,6 +18,8 @@
 
 #define DISCOVERY_MESSAGE_TIMEOUT_SEC 5 
 
+#define MAX_DATAGRAM_SEGMENTS 16
+
 namespace udp_srv {
 
 namespace {
@@ -31,7 +33,6 @@ namespace {
     const char *TAG = "UdpSrv";
     
     BufferType rx_buffer;
-    BufferType tx_buffer;
     int addr_family = AF_INET;
     int ip_protocol = IPPROTO_IP;
     
@@ -87,6 +88,7 @@ bool sendDiscoveryMessage() {
 
     DiscoveryMessage msg = {};
     msg.devId = common::getCpuId();
+    messages::MsgBufferType<DiscoveryMessage> tx_buffer;
     const auto msgLen = messages::create(tx_buffer, msg);
 
     if (0 < msgLen) {
@@ -141,6 +143,15 @@ void run() {
                 len -= sizeof(DiscoveryMessage);
                 ESP_LOGI(TAG, "Received discovery message, devId=%d, ip=%s port=%d", msg.devId, toString(sourceAddr.sin_addr).c_str(), sourceAddr.sin_port);
                 g_clients.emplace(sourceAddr.sin_addr.s_addr, sourceAddr.sin_port);
+                break;
+            }
+            case messages::BusBatch::ID: {
+                auto onBusBatch = messages::getCallbacs().onBusBatch;
+                if (onBusBatch) {
+                    streams::ArrayInputStream stream(&rx_buffer[offset], len);
+                    onBusBatch(stream);
+                }
+                break;
             }
             default:
                 break;
@@ -177,6 +188,39 @@ bool sendData(const char* data, int len) {
     return true;
 }
 
+bool sendData(const streams::SegmentedOutputStream &datagram) {
+    if (g_sock < 0 || datagram.segmentsCount() > MAX_DATAGRAM_SEGMENTS) {
+        return false;
+    }
+
+    iovec iov[MAX_DATAGRAM_SEGMENTS];
+    const auto segments = datagram.segments();
+    for (unsigned int i = 0; i < datagram.segmentsCount(); ++i) {
+        iov[i].iov_base = const_cast<char *>(segments[i].data);
+        iov[i].iov_len = segments[i].size;
+    }
+
+    sockaddr_in destAddr = {};
+    destAddr.sin_family = AF_INET;
+    msghdr msg = {};
+    msg.msg_name = &destAddr;
+    msg.msg_namelen = sizeof(destAddr);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = datagram.segmentsCount();
+    for (const auto& info : g_clients) {
+        destAddr.sin_addr.s_addr = info.addr;
+        destAddr.sin_port = info.port;
+        int errorCode = sendmsg(g_sock, &msg, 0);
+        if (errorCode < 0) {
+            ESP_LOGE(TAG, "Error occured during sending: errno %d", errorCode);
+            close_socket();
+            return false;
+        }
+    }
+
+    return true;
+}
+
 std::string toString(const in_addr &ip4addr) {
     char addr_str[128];
     inet_ntoa_r(ip4addr, addr_str, sizeof(addr_str) - 1);
@@ -0,0 +1,317 @@
+#include "Bus.h"
+#include "BusBridge.h"
+#include "InputStream.h"
+#include "OutputStream.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using ClockType = std::chrono::steady_clock;
+
+constexpr uint16_t BasePort = 47310;
+constexpr bus::TopicId Topic = bus::topic::Dimmer;
+
+// ExampleCmd1 carries the low 31 bits of the send time in microseconds
+int32_t nowUs() {
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>( ClockType::now().time_since_epoch() ).count();
+    return static_cast<int32_t>( us & 0x7fffffff );
+}
+
+int64_t elapsedUs( int32_t sentAtUs ) {
+    return ( nowUs() - sentAtUs ) & 0x7fffffff;
+}
+
+class Consumer : public bus::IBusClient {
+public:
+    using IBusClient::IBusClient;
+
+    void run( const std::atomic<bool>& isStopped ) {
+        while( !isStopped.load( std::memory_order_relaxed ) ) {
+            drain( bus::Mailbox::LENGTH, 1 );
+        }
+    }
+
+    std::vector<int64_t> latencies;
+    std::atomic<uint64_t> received{ 0 };
+
+protected:
+    void receive( const bus::BusAddr from, const bus::BusAddr to, const bus::IBusCommand& msg ) override {
+        latencies.push_back( elapsedUs( static_cast<const bus::command::ExampleCmd1&>( msg ).value ) );
+        received.fetch_add( 1, std::memory_order_release );
+    }
+};
+
+class Producer : public bus::IBusClient {
+public:
+    using IBusClient::IBusClient;
+
+protected:
+    void receive( const bus::BusAddr from, const bus::BusAddr to, const bus::IBusCommand& msg ) override {}
+};
+
+/**
+ * One board: a bus, its bridge and a UDP socket on the loopback interface
+ */
+struct Node {
+    bus::Bus bus;
+    int sock = -1;
+    sockaddr_in peer = {};
+    std::unique_ptr<udp_bridge::BusBridge> bridge;
+    std::thread bridgeTask;
+    std::thread socketTask;
+
+    Node( uint32_t nodeId, uint16_t port, uint16_t peerPort ) {
+        sock = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+        int bufferSize = 1 << 20;
+        setsockopt( sock, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof( bufferSize ) );
+        timeval timeout = { 0, 10000 };
+        setsockopt( sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+
+        sockaddr_in local = {};
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+        local.sin_port = htons( port );
+        bind( sock, reinterpret_cast<const sockaddr*>( &local ), sizeof( local ) );
+
+        peer = local;
+        peer.sin_port = htons( peerPort );
+
+        bridge.reset( new udp_bridge::BusBridge( bus, nodeId, [this]( const char* data, int len ) {
+            return len == sendto( sock, data, len, 0, reinterpret_cast<const sockaddr*>( &peer ), sizeof( peer ) );
+        }, bus::DeliveryPolicy::block( 10 ) ) );
+        bridge->bridge( Topic );
+    }
+
+    ~Node() {
+        close( sock );
+    }
+
+    void start( const std::atomic<bool>& isStopped ) {
+        bridgeTask = std::thread( [this, &isStopped] {
+            while( !isStopped.load( std::memory_order_relaxed ) ) {
+                bridge->poll( 1 );
+            }
+        } );
+        socketTask = std::thread( [this, &isStopped] {
+            messages::BufferType buffer;
+            while( !isStopped.load( std::memory_order_relaxed ) ) {
+                const auto len = recv( sock, buffer.data(), buffer.size(), 0 );
+                messages::MsgIdType msgId = 0;
+                if( len < static_cast<ssize_t>( sizeof( msgId ) ) ) {
+                    continue;
+                }
+                std::memcpy( &msgId, buffer.data(), sizeof( msgId ) );
+                if( msgId == messages::BusBatch::ID ) {
+                    streams::ArrayInputStream stream( buffer.data() + sizeof( msgId ), len - sizeof( msgId ) );
+                    bridge->inject( stream );
+                }
+            }
+        } );
+    }
+
+    void join() {
+        bridgeTask.join();
+        socketTask.join();
+    }
+};
+
+void benchBridge( std::size_t window ) {
+    constexpr int Messages = 50000;
+
+    Node nodeA( 1, BasePort, BasePort + 1 );
+    Node nodeB( 2, BasePort + 1, BasePort );
+
+    Producer producer( nodeA.bus );
+    producer.initialize();
+    Consumer consumer( nodeB.bus );
+    consumer.initialize();
+    nodeB.bus.join( Topic, consumer );
+    consumer.latencies.reserve( Messages );
+
+    std::atomic<bool> isStopped{ false };
+    nodeA.start( isStopped );
+    nodeB.start( isStopped );
+    std::thread consumerTask( [&] { consumer.run( isStopped ); } );
+
+    uint64_t sent = 0;
+    const auto start = ClockType::now();
+    const auto deadline = start + std::chrono::seconds( 10 );
+    while( sent < Messages && ClockType::now() < deadline ) {
+        if( sent - consumer.received.load( std::memory_order_acquire ) >= window ) {
+            std::this_thread::yield();
+            continue;
+        }
+        if( bus::SendResult::Delivered == producer.send( Topic, bus::command::ExampleCmd1( nowUs() ), bus::Priority::Normal, bus::DeliveryPolicy::block( 10 ) ) ) {
+            ++sent;
+        }
+    }
+    while( consumer.received.load() < sent && ClockType::now() < deadline ) {
+        std::this_thread::yield();
+    }
+    const double elapsedSec = std::chrono::duration<double>( ClockType::now() - start ).count();
+    isStopped = true;
+    consumerTask.join();
+    nodeA.join();
+    nodeB.join();
+
+    auto latencies = consumer.latencies;
+    std::sort( latencies.begin(), latencies.end() );
+    const auto statsA = nodeA.bridge->stats();
+    const auto statsB = nodeB.bridge->stats();
+    std::printf( "%8zu %12.0f %10.1f %10.1f %12.1f %10llu %10u\n",
+                 window,
+                 consumer.received.load() / elapsedSec,
+                 latencies.empty() ? 0.0 : static_cast<double>( latencies[latencies.size() / 2] ),
+                 latencies.empty() ? 0.0 : static_cast<double>( latencies[latencies.size() * 99 / 100] ),
+                 statsA.datagrams ? static_cast<double>( statsA.forwarded ) / statsA.datagrams : 0.0,
+                 static_cast<unsigned long long>( sent - consumer.received.load() ),
+                 statsA.injected + statsA.refused + statsB.forwarded );
+}
+
+int64_t threadCpuNs() {
+    timespec ts;
+    clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts );
+    return static_cast<int64_t>( ts.tv_sec ) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Header, a payload borrowed from the caller and a sequence number trailer
+ */
+bool composeDatagram( streams::OutputBase& stream, streams::ByteView payload, uint32_t sequence ) {
+    const messages::MsgIdType id = messages::BusBatch::ID;
+    return stream.write( id ) && stream.write( messages::BusBatch{ 1 } ) && stream.write( payload ) && stream.write( sequence );
+}
+
+/**
+ * Flattened into one buffer and sent with sendto() vs segments sent with sendmsg(), as udp_srv::sendData() does
+ */
+void benchVectoredSend( std::size_t payloadSize ) {
+    constexpr int Datagrams = 100000;
+
+    const int rx = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+    const int tx = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+    timeval timeout = { 0, 10000 };
+    setsockopt( rx, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+    sockaddr_in peer = {};
+    peer.sin_family = AF_INET;
+    peer.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    peer.sin_port = htons( BasePort + 2 );
+    bind( rx, reinterpret_cast<const sockaddr*>( &peer ), sizeof( peer ) );
+
+    std::vector<uint8_t> blob( payloadSize, 0x5a );
+    const streams::ByteView payload( reinterpret_cast<const char*>( blob.data() ), blob.size() );
+
+    std::atomic<bool> isStopped{ false };
+    std::atomic<uint64_t> received{ 0 };
+    std::atomic<uint64_t> malformed{ 0 };
+    std::thread receiver( [&] {
+        std::array<char, 2048> buffer;
+        while( !isStopped.load( std::memory_order_relaxed ) ) {
+            const auto len = recv( rx, buffer.data(), buffer.size(), 0 );
+            if( len <= 0 ) {
+                continue;
+            }
+            streams::ArrayInputStream stream( buffer.data(), len );
+            messages::MsgIdType id = 0;
+            messages::BusBatch batch;
+            streams::ByteView bytes;
+            uint32_t sequence = 0;
+            const bool isValid = stream.read( id ) && stream.read( batch ) && stream.read( bytes ) && stream.read( sequence ) &&
+                                 bytes.size() == payloadSize && !stream.size();
+            ( isValid ? received : malformed ).fetch_add( 1, std::memory_order_relaxed );
+        }
+    } );
+
+    auto run = [&]( auto send ) {
+        const int64_t start = threadCpuNs();
+        uint64_t copied = 0;
+        uint64_t segments = 0;
+        for( uint32_t sequence = 0; sequence < Datagrams; ++sequence ) {
+            const auto result = send( sequence );
+            copied += result.first;
+            segments += result.second;
+            if( sequence % 64 == 63 ) {
+                std::this_thread::yield();  // lets the receiver drain on a single core
+            }
+        }
+        return std::array<double, 3>{ static_cast<double>( threadCpuNs() - start ) / Datagrams,
+                                      static_cast<double>( copied ) / Datagrams,
+                                      static_cast<double>( segments ) / Datagrams };
+    };
+
+    std::array<char, 2048> flatBuffer;
+    const auto flat = run( [&]( uint32_t sequence ) {
+        streams::ArrayOutputStream stream( flatBuffer.data(), flatBuffer.size() );
+        composeDatagram( stream, payload, sequence );
+        sendto( tx, flatBuffer.data(), stream.dataSize(), 0, reinterpret_cast<const sockaddr*>( &peer ), sizeof( peer ) );
+        return std::make_pair( stream.dataSize(), 1u );
+    } );
+
+    std::array<streams::SegmentedOutputStream::Segment, 8> segments;
+    std::array<char, 64> inlineBuffer;
+    const auto vectored = run( [&]( uint32_t sequence ) {
+        streams::SegmentedOutputStream stream( segments.data(), segments.size(), inlineBuffer.data(), inlineBuffer.size() );
+        composeDatagram( stream, payload, sequence );
+        iovec iov[8];
+        for( uint32_t i = 0; i < stream.segmentsCount(); ++i ) {
+            iov[i].iov_base = const_cast<char*>( stream.segments()[i].data );
+            iov[i].iov_len = stream.segments()[i].size;
+        }
+        msghdr msg = {};
+        msg.msg_name = &peer;
+        msg.msg_namelen = sizeof( peer );
+        msg.msg_iov = iov;
+        msg.msg_iovlen = stream.segmentsCount();
+        sendmsg( tx, &msg, 0 );
+        return std::make_pair( stream.copiedSize(), stream.segmentsCount() );
+    } );
+
+    std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+    isStopped = true;
+    receiver.join();
+    close( tx );
+    close( rx );
+
+    std::printf( "%8zu %10.0f %8.0f %10.0f %8.0f %9.1f %10llu %10llu\n",
+                 payloadSize,
+                 flat[1],
+                 flat[0],
+                 vectored[1],
+                 vectored[0],
+                 vectored[2],
+                 static_cast<unsigned long long>( received.load() ),
+                 static_cast<unsigned long long>( malformed.load() ) );
+}
+
+}  // namespace
+
+int main() {
+    std::printf( "bus bridge over UDP loopback, node A producer -> node B consumer\n" );
+    std::printf( "%8s %12s %10s %10s %12s %10s %10s\n", "window", "msg/s", "p50 us", "p99 us", "msg/datagram", "lost", "looped" );
+    for( std::size_t window : { 1, 16, 64 } ) {
+        benchBridge( window );
+    }
+
+    std::printf( "\nsend of header + payload + trailer over UDP loopback, per datagram, 100000 datagrams per path\n" );
+    std::printf( "%8s %10s %8s %10s %8s %9s %10s %10s\n", "payload", "flat copy", "cpu ns", "vec copy", "cpu ns", "segments", "received", "malformed" );
+    for( std::size_t payloadSize : { 16, 64, 256, 1024, 1400 } ) {
+        benchVectoredSend( payloadSize );
+    }
+    return 0;
+}
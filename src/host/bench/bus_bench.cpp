@@ -0,0 +1,1015 @@
+#include "Bus.h"
+
+#include <esp_timer.h>
+#include <freertos/task.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <memory>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using ClockType = std::chrono::steady_clock;
+
+std::atomic<uint64_t> g_heapAllocations{ 0 };
+volatile uintptr_t g_sink = 0;  // keeps resolve results alive
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( ClockType::now().time_since_epoch() ).count();
+}
+
+struct Probe : public bus::IBusCommand {
+    int64_t sentAtNs;
+    bool isTagged;
+
+    explicit Probe( int64_t _sentAtNs, bool _isTagged = false )
+    : sentAtNs( _sentAtNs )
+    , isTagged( _isTagged ) {}
+
+    void accept( const bus::BusAddr from, const bus::BusAddr to, bus::IBusCommandVisitor& client ) const override {}
+};
+
+class BenchClient : public bus::IBusClient {
+public:
+    using IBusClient::IBusClient;
+
+    void poll( TickType_t waitTime ) {
+        if( batch > 1 ) {
+            wakeUps += drain( batch, waitTime ) ? 1 : 0;
+        }
+        else {
+            tryReceive( waitTime );
+        }
+    }
+
+    void run( const std::atomic<bool>& isStopped ) {
+        while( !isStopped.load( std::memory_order_relaxed ) ) {
+            poll( 1 );
+        }
+        poll( 0 );
+    }
+
+    std::vector<int64_t> latencies;
+    std::vector<int64_t> taggedLatencies;
+    std::atomic<uint64_t> received{ 0 };
+    std::chrono::microseconds handlerDelay{ 0 };
+    std::size_t batch = 1;  // messages per drain(), 1 - tryReceive()
+    uint64_t wakeUps = 0;
+
+protected:
+    void receive( const bus::BusAddr from, const bus::BusAddr to, const bus::IBusCommand& msg ) override {
+        const auto& probe = static_cast<const Probe&>( msg );
+        ( probe.isTagged ? taggedLatencies : latencies ).push_back( nowNs() - probe.sentAtNs );
+        received.fetch_add( 1, std::memory_order_release );
+        if( handlerDelay.count() ) {
+            std::this_thread::sleep_for( handlerDelay );
+        }
+    }
+};
+
+struct Percentiles {
+    double p50Us = 0;
+    double p99Us = 0;
+};
+
+Percentiles percentiles( std::vector<int64_t> values ) {
+    Percentiles result;
+    if( values.empty() ) {
+        return result;
+    }
+    std::sort( values.begin(), values.end() );
+    result.p50Us = values[values.size() / 2] / 1000.0;
+    result.p99Us = values[values.size() * 99 / 100] / 1000.0;
+    return result;
+}
+
+struct DispatchVisitor : public bus::IBusCommandVisitor {
+    int64_t sum = 0;
+
+    void visit( const bus::BusAddr from, const bus::BusAddr to, const bus::command::ExampleCmd1& command ) final {
+        sum += command.value;
+    }
+
+    void visit( const bus::BusAddr from, const bus::BusAddr to, const bus::command::ExampleCmd2& command ) final {
+        sum += command.id;
+    }
+};
+
+class DispatchClient : public bus::BusMessageHandler<DispatchVisitor> {
+public:
+    using BusMessageHandler::BusMessageHandler;
+
+    void poll( TickType_t waitTime ) {
+        tryReceive( waitTime );
+    }
+
+    void dispatch( const bus::IBusCommand& msg ) {
+        BusMessageHandler::receive( 0, 0, msg );
+    }
+
+    void dispatch( const bus::command::Variant& msg ) {
+        BusMessageHandler::receive( 0, 0, msg );
+    }
+};
+
+/**
+ * Keeps the number of undelivered messages below the mailbox length,
+ * otherwise the benchmark would measure drops instead of delivery.
+ */
+void waitForRoom( uint64_t sent, const std::vector<BenchClient*>& receivers ) {
+    const uint64_t limit = bus::Mailbox::LENGTH / 2;
+    for( auto receiver : receivers ) {
+        while( sent - receiver->received.load( std::memory_order_acquire ) >= limit ) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/**
+ * Registry of the bus before flat tables, kept to compare resolve cost
+ */
+class ListRegistry {
+public:
+    void connect( bus::BusAddr addr, bus::Mailbox* mailbox ) {
+        m_clients.emplace_front( Client{ addr, mailbox } );
+    }
+
+    bus::Mailbox* resolve( bus::BusAddr addr ) {
+        auto i = std::find_if( m_clients.begin(), m_clients.end(), [&addr]( Client& client ) -> bool {
+            return addr == client.addr;
+        } );
+        return i != m_clients.end() ? i->mailbox : nullptr;
+    }
+
+private:
+    struct Client {
+        bus::BusAddr addr;
+        bus::Mailbox* mailbox;
+    };
+    std::list<Client> m_clients;
+};
+
+void benchResolve() {
+    constexpr int Iterations = 1000000;
+    std::printf( "\nresolve / send+receive cost\n" );
+    std::printf( "%8s %14s %14s %18s\n", "clients", "list ns/op", "table ns/op", "send+recv ns/op" );
+
+    for( std::size_t clientsCount : { 4, 32, 256 } ) {
+        bus::Bus bus;
+        std::vector<std::unique_ptr<BenchClient>> clients;
+        std::vector<bus::BusAddr> addrs;
+        ListRegistry listRegistry;
+        for( std::size_t i = 0; i < clientsCount; ++i ) {
+            clients.emplace_back( new BenchClient( bus ) );
+            clients.back()->initialize();
+            addrs.push_back( clients.back()->addr() );
+        }
+        for( auto i = addrs.rbegin(); i != addrs.rend(); ++i ) {
+            listRegistry.connect( *i, nullptr );
+        }
+
+        std::mt19937 random( 42 );
+        std::vector<std::size_t> order( Iterations );
+        for( auto& i : order ) {
+            i = random() % clientsCount;
+        }
+
+        uintptr_t sink = 0;
+        auto start = ClockType::now();
+        for( auto i : order ) {
+            sink += reinterpret_cast<uintptr_t>( listRegistry.resolve( addrs[i] ) );
+        }
+        const double listNs = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / Iterations;
+
+        start = ClockType::now();
+        for( auto i : order ) {
+            sink += reinterpret_cast<uintptr_t>( bus.resolve( addrs[i] ) );
+        }
+        const double tableNs = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / Iterations;
+
+        const int sendIterations = Iterations / 10;
+        start = ClockType::now();
+        for( int n = 0; n < sendIterations; ++n ) {
+            auto& receiver = *clients[order[n]];
+            clients[0]->send( receiver.addr(), Probe( 0 ) );
+            receiver.poll( 0 );
+        }
+        const double sendNs = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / sendIterations;
+
+        g_sink = sink;
+        std::printf( "%8zu %14.1f %14.1f %18.1f\n", clientsCount, listNs, tableNs, sendNs );
+    }
+}
+
+void benchNamedSend() {
+    constexpr int Iterations = 200000;
+    std::printf( "\nnamed send+receive cost, target is the last of N groups\n" );
+    std::printf( "%8s %14s %14s\n", "groups", "name ns/op", "topic ns/op" );
+
+    for( std::size_t groupsCount : { 1, 8, 16 } ) {
+        bus::Bus bus;
+        BenchClient sender( bus );
+        BenchClient receiver( bus );
+        sender.initialize();
+        receiver.initialize();
+        std::vector<std::string> names;
+        for( std::size_t i = 0; i < groupsCount; ++i ) {
+            names.push_back( "sensors/temperature/" + std::to_string( i ) );
+            bus.join( names.back().c_str(), receiver );
+        }
+        const char* name = names.back().c_str();
+
+        auto start = ClockType::now();
+        for( int n = 0; n < Iterations; ++n ) {
+            sender.send( name, Probe( 0 ) );
+            receiver.poll( 0 );
+        }
+        const double nameNs = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / Iterations;
+
+        const auto topic = bus::TopicId::hash( name );
+        start = ClockType::now();
+        for( int n = 0; n < Iterations; ++n ) {
+            sender.send( topic, Probe( 0 ) );
+            receiver.poll( 0 );
+        }
+        const double topicNs = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / Iterations;
+
+        std::printf( "%8zu %14.1f %14.1f\n", groupsCount, nameNs, topicNs );
+    }
+}
+
+void benchUnicast( std::size_t batch ) {
+    constexpr int Messages = 200000;
+
+    bus::Bus bus;
+    BenchClient sender( bus );
+    BenchClient receiver( bus );
+    sender.initialize();
+    receiver.initialize();
+    receiver.latencies.reserve( Messages );
+    receiver.batch = batch;
+
+    std::atomic<bool> isStopped{ false };
+    std::thread receiverTask( [&] { receiver.run( isStopped ); } );
+
+    const std::vector<BenchClient*> receivers{ &receiver };
+    const auto allocationsBefore = g_heapAllocations.load();
+    const auto start = ClockType::now();
+    for( int n = 0; n < Messages; ++n ) {
+        waitForRoom( n, receivers );
+        sender.send( receiver.addr(), Probe( nowNs() ) );
+    }
+    while( receiver.received.load() < Messages && bus.poolStats().inUse ) {
+        std::this_thread::yield();
+    }
+    const double elapsedSec = std::chrono::duration<double>( ClockType::now() - start ).count();
+    const auto allocations = g_heapAllocations.load() - allocationsBefore;
+    isStopped = true;
+    receiverTask.join();
+
+    const auto latency = percentiles( receiver.latencies );
+    if( batch > 1 ) {
+        std::printf( "\nunicast, 1 producer -> 1 consumer, drain( %zu )\n", batch );
+    }
+    else {
+        std::printf( "\nunicast, 1 producer -> 1 consumer, tryReceive()\n" );
+    }
+    std::printf( "  throughput      %12.0f msg/s\n", receiver.received.load() / elapsedSec );
+    std::printf( "  latency p50/p99 %8.2f / %.2f us\n", latency.p50Us, latency.p99Us );
+    std::printf( "  heap allocs/msg %12.3f\n", static_cast<double>( allocations ) / Messages );
+    if( receiver.wakeUps ) {
+        std::printf( "  msg/wakeup      %12.2f\n", static_cast<double>( receiver.received.load() ) / receiver.wakeUps );
+    }
+}
+
+void benchGroup( std::size_t membersCount, bool hasSlowMember ) {
+    constexpr int Messages = 2000;
+
+    bus::Bus bus;
+    BenchClient sender( bus );
+    sender.initialize();
+    std::vector<std::unique_ptr<BenchClient>> members;
+    std::vector<BenchClient*> receivers;
+    for( std::size_t i = 0; i < membersCount; ++i ) {
+        members.emplace_back( new BenchClient( bus ) );
+        members.back()->initialize();
+        members.back()->latencies.reserve( Messages );
+        bus.join( "bench", *members.back() );
+        receivers.push_back( members.back().get() );
+    }
+    if( hasSlowMember ) {
+        members.front()->handlerDelay = std::chrono::microseconds( 200 );
+        receivers.erase( receivers.begin() );  // let the slow one drop
+    }
+
+    std::atomic<bool> isStopped{ false };
+    std::vector<std::thread> tasks;
+    for( auto& member : members ) {
+        tasks.emplace_back( [&isStopped, &member] { member->run( isStopped ); } );
+    }
+
+    const auto group = bus.resolve( "bench" );
+    const auto start = ClockType::now();
+    for( int n = 0; n < Messages; ++n ) {
+        waitForRoom( n, receivers );
+        sender.send( group, Probe( nowNs() ) );
+    }
+    for( auto receiver : receivers ) {
+        while( receiver->received.load() < Messages ) {
+            std::this_thread::yield();
+        }
+    }
+    const double elapsedSec = std::chrono::duration<double>( ClockType::now() - start ).count();
+    isStopped = true;
+    for( auto& task : tasks ) {
+        task.join();
+    }
+
+    std::vector<int64_t> fastLatencies;
+    for( auto receiver : receivers ) {
+        fastLatencies.insert( fastLatencies.end(), receiver->latencies.begin(), receiver->latencies.end() );
+    }
+    const auto latency = percentiles( fastLatencies );
+    std::printf( "%8zu %6s %14.0f %10.2f %10.2f\n",
+                 membersCount,
+                 hasSlowMember ? "yes" : "no",
+                 Messages * receivers.size() / elapsedSec,
+                 latency.p50Us,
+                 latency.p99Us );
+}
+
+void benchProducers() {
+    constexpr int MessagesPerProducer = 100000;
+    std::printf( "\nN producers -> 1 consumer\n" );
+    std::printf( "%10s %14s %10s %10s\n", "producers", "msg/s", "p50 us", "p99 us" );
+
+    for( int producersCount : { 1, 4, 8 } ) {
+        bus::Bus bus;
+        BenchClient receiver( bus );
+        receiver.initialize();
+        receiver.latencies.reserve( MessagesPerProducer * producersCount );
+        std::vector<std::unique_ptr<BenchClient>> producers;
+        for( int i = 0; i < producersCount; ++i ) {
+            producers.emplace_back( new BenchClient( bus ) );
+            producers.back()->initialize();
+        }
+
+        std::atomic<bool> isStopped{ false };
+        std::thread receiverTask( [&] { receiver.run( isStopped ); } );
+
+        std::atomic<uint64_t> sent{ 0 };
+        const uint64_t total = static_cast<uint64_t>( MessagesPerProducer ) * producersCount;
+        const auto start = ClockType::now();
+        std::vector<std::thread> tasks;
+        for( auto& producer : producers ) {
+            tasks.emplace_back( [&, producer = producer.get()] {
+                for( int n = 0; n < MessagesPerProducer; ++n ) {
+                    while( sent.load() - receiver.received.load( std::memory_order_acquire ) >= bus::Mailbox::LENGTH / 2 ) {
+                        std::this_thread::yield();
+                    }
+                    sent.fetch_add( 1 );
+                    producer->send( receiver.addr(), Probe( nowNs() ) );
+                }
+            } );
+        }
+        for( auto& task : tasks ) {
+            task.join();
+        }
+        while( receiver.received.load() < total && bus.poolStats().inUse ) {
+            std::this_thread::yield();
+        }
+        const double elapsedSec = std::chrono::duration<double>( ClockType::now() - start ).count();
+        isStopped = true;
+        receiverTask.join();
+
+        const auto latency = percentiles( receiver.latencies );
+        std::printf( "%10d %14.0f %10.2f %10.2f\n", producersCount, receiver.received.load() / elapsedSec, latency.p50Us, latency.p99Us );
+    }
+}
+
+void benchDispatch() {
+    constexpr int Iterations = 1000000;
+    constexpr int Commands = 1024;
+
+    bus::Bus bus;
+    DispatchClient sender( bus );
+    DispatchClient receiver( bus );
+    sender.initialize();
+    receiver.initialize();
+
+    std::mt19937 random( 42 );
+    std::vector<std::unique_ptr<bus::IBusCommand>> erased;
+    std::vector<bus::command::Variant> listed;
+    for( int i = 0; i < Commands; ++i ) {
+        if( random() % 2 ) {
+            erased.emplace_back( new bus::command::ExampleCmd1( i ) );
+            listed.emplace_back( bus::command::ExampleCmd1( i ) );
+        }
+        else {
+            erased.emplace_back( new bus::command::ExampleCmd2( i, 0.f ) );
+            listed.emplace_back( bus::command::ExampleCmd2( i, 0.f ) );
+        }
+    }
+
+    auto start = ClockType::now();
+    for( int n = 0; n < Iterations; ++n ) {
+        receiver.dispatch( *erased[n % Commands] );
+    }
+    const double visitorNs = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / Iterations;
+
+    start = ClockType::now();
+    for( int n = 0; n < Iterations; ++n ) {
+        receiver.dispatch( listed[n % Commands] );
+    }
+    const double variantNs = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / Iterations;
+
+    const int sendIterations = Iterations / 10;
+    const auto allocationsBefore = g_heapAllocations.load();
+    start = ClockType::now();
+    for( int n = 0; n < sendIterations; ++n ) {
+        sender.send( receiver.addr(), std::unique_ptr<bus::IBusCommand>( new bus::command::ExampleCmd1( n ) ) );
+        receiver.poll( 0 );
+    }
+    const double visitorSendNs = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / sendIterations;
+    const auto visitorAllocations = g_heapAllocations.load() - allocationsBefore;
+
+    start = ClockType::now();
+    for( int n = 0; n < sendIterations; ++n ) {
+        sender.send( receiver.addr(), bus::command::ExampleCmd1( n ) );
+        receiver.poll( 0 );
+    }
+    const double variantSendNs = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / sendIterations;
+    const auto variantAllocations = g_heapAllocations.load() - allocationsBefore - visitorAllocations;
+
+    g_sink = receiver.sum;
+    std::printf( "\ncommand dispatch, ExampleCmd1/ExampleCmd2\n" );
+    std::printf( "%22s %12s %18s %12s\n", "", "dispatch ns", "send+recv ns", "allocs/msg" );
+    std::printf( "%22s %12.2f %18.1f %12.3f\n", "virtual accept/visit", visitorNs, visitorSendNs, static_cast<double>( visitorAllocations ) / sendIterations );
+    std::printf( "%22s %12.2f %18.1f %12.3f\n", "inline variant", variantNs, variantSendNs, static_cast<double>( variantAllocations ) / sendIterations );
+}
+
+/**
+ * Control probes sent while a bulk producer keeps the receiver's bulk lane full
+ */
+void benchPriority( bus::Priority controlPriority ) {
+    constexpr int ControlMessages = 200;
+
+    bus::Bus bus;
+    BenchClient bulkSender( bus );
+    BenchClient controlSender( bus );
+    BenchClient receiver( bus );
+    bulkSender.initialize();
+    controlSender.initialize();
+    receiver.initialize();
+    receiver.handlerDelay = std::chrono::microseconds( 20 );
+
+    std::atomic<bool> isStopped{ false };
+    std::atomic<bool> isBulkStopped{ false };
+    std::thread receiverTask( [&] { receiver.run( isStopped ); } );
+    std::thread bulkTask( [&] {
+        while( !isBulkStopped.load() ) {
+            bulkSender.send( receiver.addr(), Probe( nowNs() ), bus::Priority::Bulk );
+            std::this_thread::yield();
+        }
+    } );
+
+    for( int n = 0; n < ControlMessages; ++n ) {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 2 ) );
+        controlSender.send( receiver.addr(), Probe( nowNs(), true ), controlPriority );
+    }
+    std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+    isBulkStopped = true;
+    bulkTask.join();
+    isStopped = true;
+    receiverTask.join();
+
+    const auto latency = percentiles( receiver.taggedLatencies );
+    const auto maxNs = receiver.taggedLatencies.empty()
+                           ? 0
+                           : *std::max_element( receiver.taggedLatencies.begin(), receiver.taggedLatencies.end() );
+    std::printf( "%14s %10zu %10.1f %10.1f %10.1f\n",
+                 controlPriority == bus::Priority::Control ? "control lane" : "bulk lane",
+                 receiver.taggedLatencies.size(),
+                 latency.p50Us,
+                 latency.p99Us,
+                 maxNs / 1000.0 );
+}
+
+#if BUS_ENABLE_STATS
+void benchStats() {
+    constexpr int Messages = 2000;
+
+    bus::Bus bus;
+    BenchClient sender( bus );
+    std::vector<std::unique_ptr<BenchClient>> members;
+    for( int i = 0; i < 4; ++i ) {
+        members.emplace_back( new BenchClient( bus ) );
+        members.back()->initialize();
+        bus.join( "stats", *members.back() );
+    }
+    sender.initialize();
+    members.back()->handlerDelay = std::chrono::microseconds( 200 );  // overflows its mailbox
+
+    std::atomic<bool> isStopped{ false };
+    std::vector<std::thread> tasks;
+    for( auto& member : members ) {
+        tasks.emplace_back( [&isStopped, &member] { member->run( isStopped ); } );
+    }
+    const auto group = bus.resolve( "stats" );
+    for( int n = 0; n < Messages; ++n ) {
+        sender.send( group, Probe( nowNs() ) );
+        if( n % 100 == 0 ) {
+            sender.send( bus::BusAddr( -1000 ), Probe( nowNs() ) );  // never connected
+        }
+        std::this_thread::sleep_for( std::chrono::microseconds( 20 ) );
+    }
+    std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+    isStopped = true;
+    for( auto& task : tasks ) {
+        task.join();
+    }
+
+    auto printCounters = []( const char* name, const bus::TrafficCounters& counters ) {
+        std::printf( "  %-14s %8u %10u %8u %11u\n", name, counters.sent, counters.delivered, counters.droppedFull, counters.droppedUnresolved );
+    };
+    const auto stats = bus.stats();
+    std::printf( "\nbus statistics, group of 4 with a slow member\n" );
+    std::printf( "  %-14s %8s %10s %8s %11s\n", "", "sent", "delivered", "full", "unresolved" );
+    printCounters( "total", stats.total );
+    printCounters( "sender", bus.clientStats( sender.addr() ) );
+    printCounters( "group", bus.groupStats( group ) );
+    printCounters( "fast member", bus.clientStats( members.front()->addr() ) );
+    printCounters( "slow member", bus.clientStats( members.back()->addr() ) );
+    std::printf( "  mailbox high-water fast/slow %u / %u\n",
+                 bus.clientStats( members.front()->addr() ).mailboxHighWater,
+                 bus.clientStats( members.back()->addr() ).mailboxHighWater );
+    std::printf( "  latency us  " );
+    for( auto limit : bus::LatencyHistogram::LIMITS_US ) {
+        std::printf( " <%-6u", limit );
+    }
+    std::printf( " rest\n  messages    " );
+    for( auto count : stats.latency ) {
+        std::printf( " %7u", count );
+    }
+    std::printf( "\n" );
+}
+#endif
+
+void benchBackpressure( const char* name, bus::DeliveryPolicy policy ) {
+    constexpr auto Duration = std::chrono::milliseconds( 300 );
+
+    bus::Bus bus;
+    BenchClient sender( bus );
+    BenchClient receiver( bus );
+    sender.initialize();
+    receiver.initialize();
+    receiver.handlerDelay = std::chrono::microseconds( 50 );
+
+    std::atomic<bool> isStopped{ false };
+    std::thread receiverTask( [&] { receiver.run( isStopped ); } );
+
+    uint64_t attempts = 0;
+    uint64_t dropped = 0;
+    const auto start = ClockType::now();
+    while( ClockType::now() - start < Duration ) {
+        ++attempts;
+        if( bus::SendResult::Delivered != sender.send( receiver.addr(), Probe( nowNs() ), bus::Priority::Normal, policy ) ) {
+            ++dropped;
+            std::this_thread::yield();  // the producer backs off instead of building more messages
+        }
+    }
+    std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+    isStopped = true;
+    receiverTask.join();
+
+    const auto latency = percentiles( receiver.latencies );
+    std::printf( "%12s %10llu %10llu %10llu %10.1f %10.1f\n",
+                 name,
+                 static_cast<unsigned long long>( attempts ),
+                 static_cast<unsigned long long>( receiver.received.load() ),
+                 static_cast<unsigned long long>( dropped ),
+                 latency.p50Us,
+                 latency.p99Us );
+}
+
+void benchLatest( bool isCoalescing ) {
+    constexpr int Sensors = 4;
+    constexpr int Updates = 4000;
+
+    bus::Bus bus;
+    BenchClient sensors( bus );
+    BenchClient consumer( bus );
+    sensors.initialize();
+    consumer.initialize();
+    consumer.handlerDelay = std::chrono::microseconds( 100 );
+    bus.join( "temperature", consumer );
+    const auto topic = isCoalescing ? bus.coalesce( "temperature" ) : bus.resolve( "temperature" );
+
+    std::atomic<bool> isStopped{ false };
+    std::thread consumerTask( [&] { consumer.run( isStopped ); } );
+
+    uint64_t dropped = 0;
+    const auto start = ClockType::now();
+    for( int n = 0; n < Updates; ++n ) {
+        const uint64_t sensorId = n % Sensors;
+        const auto result = isCoalescing ? sensors.publish( topic, sensorId, Probe( nowNs() ) ) : sensors.send( topic, Probe( nowNs() ) );
+        dropped += bus::SendResult::Delivered == result ? 0 : 1;
+        std::this_thread::sleep_for( std::chrono::microseconds( 10 ) );
+    }
+    const double elapsedMs = std::chrono::duration<double, std::milli>( ClockType::now() - start ).count();
+    while( bus.poolStats().inUse ) {
+        std::this_thread::yield();
+    }
+    isStopped = true;
+    consumerTask.join();
+
+    const auto latency = percentiles( consumer.latencies );
+    std::printf( "%12s %10d %10llu %10llu %10u %10.1f %10.1f %10.1f\n",
+                 isCoalescing ? "latest" : "queued",
+                 Updates,
+                 static_cast<unsigned long long>( consumer.received.load() ),
+                 static_cast<unsigned long long>( dropped ),
+                 bus.poolStats().highWater,
+                 latency.p50Us,
+                 latency.p99Us,
+                 elapsedMs );
+}
+
+class RpcServer : public bus::IBusClient {
+public:
+    using IBusClient::IBusClient;
+
+    void run( const std::atomic<bool>& isStopped ) {
+        while( !isStopped.load( std::memory_order_relaxed ) ) {
+            drain( bus::Mailbox::LENGTH, 1 );
+        }
+    }
+
+    bool isMuted = false;  // requests are left unanswered
+
+protected:
+    void receive( const bus::BusAddr from, const bus::BusAddr to, const bus::IBusCommand& msg ) override {
+        if( !isMuted ) {
+            reply( request(), Probe( static_cast<const Probe&>( msg ).sentAtNs ) );
+        }
+    }
+};
+
+class RpcCaller : public bus::IBusClient {
+public:
+    using IBusClient::IBusClient;
+
+    ~RpcCaller() override {
+        cancelCalls();  // the callback context is this object
+    }
+
+    using IBusClient::drain;
+
+    static void onResponse( void* context, bus::RpcResult result, const bus::BusAddr from, const bus::IBusCommand* response ) {
+        auto self = static_cast<RpcCaller*>( context );
+        self->lastResult = result;
+        if( response ) {
+            self->latencies.push_back( nowNs() - static_cast<const Probe*>( response )->sentAtNs );
+        }
+        self->isCompleted = true;
+    }
+
+    std::vector<int64_t> latencies;
+    bus::RpcResult lastResult = bus::RpcResult::Cancelled;
+    bool isCompleted = false;
+
+protected:
+    void receive( const bus::BusAddr from, const bus::BusAddr to, const bus::IBusCommand& msg ) override {}
+};
+
+void benchRpc() {
+    constexpr int Calls = 20000;
+
+    bus::Bus bus;
+    RpcServer server( bus );
+    RpcCaller caller( bus );
+    server.initialize();
+    caller.initialize();
+    caller.latencies.reserve( Calls );
+
+    std::atomic<bool> isStopped{ false };
+    std::thread serverTask( [&] { server.run( isStopped ); } );
+
+    int failed = 0;
+    const auto allocationsBefore = g_heapAllocations.load();
+    const auto start = ClockType::now();
+    for( int n = 0; n < Calls; ++n ) {
+        caller.isCompleted = false;
+        if( bus::SendResult::Delivered != caller.call( server.addr(), Probe( nowNs() ), &RpcCaller::onResponse, &caller, 100 ) ) {
+            ++failed;
+            continue;
+        }
+        while( !caller.isCompleted ) {
+            caller.drain( 1, 10 );
+        }
+        failed += bus::RpcResult::Ok == caller.lastResult ? 0 : 1;
+    }
+    const double elapsedSec = std::chrono::duration<double>( ClockType::now() - start ).count();
+    const auto allocations = g_heapAllocations.load() - allocationsBefore;
+
+    server.isMuted = true;
+    const auto timeoutStart = ClockType::now();
+    caller.isCompleted = false;
+    caller.call( server.addr(), Probe( nowNs() ), &RpcCaller::onResponse, &caller, 20 );
+    while( !caller.isCompleted ) {
+        caller.drain( 1, portMAX_DELAY );
+    }
+    const double timeoutMs = std::chrono::duration<double, std::milli>( ClockType::now() - timeoutStart ).count();
+    const auto timeoutResult = caller.lastResult;
+
+    caller.isCompleted = false;
+    caller.call( server.addr(), Probe( nowNs() ), &RpcCaller::onResponse, &caller, portMAX_DELAY );
+    caller.cancelCalls();
+    const bool isCancelled = caller.isCompleted && bus::RpcResult::Cancelled == caller.lastResult;
+    isStopped = true;
+    serverTask.join();
+
+    const auto latency = percentiles( caller.latencies );
+    std::printf( "\nrpc round trip, 1 caller -> 1 server\n" );
+    std::printf( "  calls/s         %12.0f\n", ( Calls - failed ) / elapsedSec );
+    std::printf( "  latency p50/p99 %8.2f / %.2f us\n", latency.p50Us, latency.p99Us );
+    std::printf( "  failed          %12d\n", failed );
+    std::printf( "  heap allocs/call %11.3f\n", static_cast<double>( allocations ) / Calls );
+    std::printf( "  20 tick timeout %12.1f ms, %s\n", timeoutMs, bus::RpcResult::Timeout == timeoutResult ? "timed out" : "unexpected result" );
+    std::printf( "  cancelCalls()   %12s\n", isCancelled ? "cancelled" : "unexpected result" );
+}
+
+int64_t threadCpuNs() {
+    timespec time = {};
+    clock_gettime( CLOCK_THREAD_CPUTIME_ID, &time );
+    return static_cast<int64_t>( time.tv_sec ) * 1000000000 + time.tv_nsec;
+}
+
+/**
+ * Receives ExampleCmd1 carrying the timer index and measures how late every
+ * firing arrives after the tick of its deadline, lateness must stay below the period
+ */
+class TimerClient : public bus::IBusClient {
+public:
+    TimerClient( bus::Bus& bus, const std::vector<TickType_t>& start, const std::vector<TickType_t>& period )
+    : IBusClient( bus )
+    , m_start( start )
+    , m_period( period ) {}
+
+    void run( const std::atomic<bool>& isStopped ) {
+        while( !isStopped.load( std::memory_order_relaxed ) ) {
+            drain( bus::Mailbox::LENGTH, 1 );
+        }
+        drain( bus::Mailbox::LENGTH, 0 );
+    }
+
+    std::vector<int64_t> lateness;
+
+protected:
+    void receive( const bus::BusAddr from, const bus::BusAddr to, const bus::IBusCommand& msg ) override {
+        // Time since the last deadline, a firing missed for an empty pool doesn't shift the following ones
+        const auto index = static_cast<const bus::command::ExampleCmd1&>( msg ).value;
+        const int64_t periodUs = static_cast<int64_t>( m_period[index] ) * portTICK_PERIOD_MS * 1000;
+        const int64_t elapsedUs = esp_timer_get_time() - static_cast<int64_t>( m_start[index] ) * portTICK_PERIOD_MS * 1000;
+        lateness.push_back( ( elapsedUs % periodUs ) * 1000 );
+    }
+
+private:
+    const std::vector<TickType_t>& m_start;
+    const std::vector<TickType_t>& m_period;
+};
+
+void benchTimers( std::size_t timersCount ) {
+    constexpr std::size_t Receivers = 4;
+    constexpr auto Duration = std::chrono::seconds( 2 );
+
+    bus::Bus bus;
+    std::vector<TickType_t> start( timersCount );
+    std::vector<TickType_t> period( timersCount );
+    std::vector<std::unique_ptr<TimerClient>> receivers;
+    for( std::size_t i = 0; i < Receivers; ++i ) {
+        receivers.emplace_back( new TimerClient( bus, start, period ) );
+        receivers.back()->initialize();
+        receivers.back()->lateness.reserve( 1 << 16 );
+    }
+
+    std::atomic<bool> isStopped{ false };
+    int64_t serviceCpuNs = 0;
+    std::thread serviceTask( [&] {
+        while( !isStopped.load( std::memory_order_relaxed ) ) {
+            bus.serviceTimers( 10 );
+        }
+        serviceCpuNs = threadCpuNs();
+    } );
+    std::vector<std::thread> tasks;
+    for( auto& receiver : receivers ) {
+        tasks.emplace_back( [&isStopped, &receiver] { receiver->run( isStopped ); } );
+    }
+
+    std::mt19937 random( 15 );
+    std::uniform_int_distribution<TickType_t> periods( 50, 500 );
+    std::vector<bus::TimerId> timers( timersCount );
+    for( std::size_t i = 0; i < timersCount; ++i ) {
+        period[i] = periods( random );
+        TickType_t now = 0;
+        do {
+            // The receivers derive the deadlines from the start tick, which must be the one sendEvery() saw
+            now = xTaskGetTickCount();
+            timers[i] = receivers.front()->sendEvery( receivers[i % Receivers]->addr(), bus::command::ExampleCmd1( static_cast<int32_t>( i ) ), period[i] );
+            if( now != xTaskGetTickCount() ) {
+                receivers.front()->cancel( timers[i] );
+                timers[i] = bus::TimerIdInvalid;
+            }
+        } while( bus::TimerIdInvalid == timers[i] );
+        start[i] = now;
+    }
+
+    std::this_thread::sleep_for( Duration );
+    for( auto timer : timers ) {
+        receivers.front()->cancel( timer );
+    }
+    std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+    isStopped = true;
+    serviceTask.join();
+    for( auto& task : tasks ) {
+        task.join();
+    }
+
+    std::vector<int64_t> lateness;
+    for( auto& receiver : receivers ) {
+        lateness.insert( lateness.end(), receiver->lateness.begin(), receiver->lateness.end() );
+    }
+    const auto stats = bus.timerStats();
+    const auto latency = percentiles( lateness );
+    std::printf( "%8zu %12.0f %10.1f %10.1f %10.1f %8llu %8u %10.2f %10.0f\n",
+                 timersCount,
+                 lateness.size() / std::chrono::duration<double>( Duration ).count(),
+                 latency.p50Us,
+                 latency.p99Us,
+                 lateness.empty() ? 0.0 : *std::max_element( lateness.begin(), lateness.end() ) / 1000.0,
+                 static_cast<unsigned long long>( stats.fired - lateness.size() ),
+                 stats.missed,
+                 100.0 * serviceCpuNs / std::chrono::duration_cast<std::chrono::nanoseconds>( Duration ).count(),
+                 stats.fired ? static_cast<double>( serviceCpuNs ) / stats.fired : 0.0 );
+}
+
+/**
+ * The same periodic sends from a task per timer looping over vTaskDelay()
+ */
+void benchTimerTasks( std::size_t timersCount ) {
+    constexpr auto Duration = std::chrono::seconds( 2 );
+
+    bus::Bus bus;
+    BenchClient receiver( bus );
+    receiver.initialize();
+    receiver.batch = bus::Mailbox::LENGTH;
+
+    std::atomic<bool> isStopped{ false };
+    std::thread receiverTask( [&] { receiver.run( isStopped ); } );
+
+    std::mt19937 random( 15 );
+    std::uniform_int_distribution<TickType_t> periods( 50, 500 );
+    std::vector<std::vector<int64_t>> lateness( timersCount );
+    std::vector<int64_t> cpuNs( timersCount );
+    std::vector<std::thread> tasks;
+    for( std::size_t i = 0; i < timersCount; ++i ) {
+        const TickType_t period = periods( random );
+        tasks.emplace_back( [&, i, period] {
+            BenchClient sender( bus );
+            sender.initialize();
+            int64_t wakeAtUs = esp_timer_get_time() + period * portTICK_PERIOD_MS * 1000;
+            while( !isStopped.load( std::memory_order_relaxed ) ) {
+                vTaskDelay( period );
+                const int64_t nowUs = esp_timer_get_time();
+                lateness[i].push_back( ( nowUs - wakeAtUs ) * 1000 );
+                sender.send( receiver.addr(), Probe( nowNs() ) );
+                wakeAtUs = nowUs + period * portTICK_PERIOD_MS * 1000;
+            }
+            cpuNs[i] = threadCpuNs();
+        } );
+    }
+
+    std::this_thread::sleep_for( Duration );
+    isStopped = true;
+    for( auto& task : tasks ) {
+        task.join();
+    }
+    receiverTask.join();
+
+    std::vector<int64_t> all;
+    int64_t totalCpuNs = 0;
+    for( std::size_t i = 0; i < timersCount; ++i ) {
+        all.insert( all.end(), lateness[i].begin(), lateness[i].end() );
+        totalCpuNs += cpuNs[i];
+    }
+    const auto latency = percentiles( all );
+    std::printf( "%8zu %12.0f %10.1f %10.1f %10.1f %8s %8s %10.2f %10.0f   task per timer\n",
+                 timersCount,
+                 all.size() / std::chrono::duration<double>( Duration ).count(),
+                 latency.p50Us,
+                 latency.p99Us,
+                 all.empty() ? 0.0 : *std::max_element( all.begin(), all.end() ) / 1000.0,
+                 "-",
+                 "-",
+                 100.0 * totalCpuNs / std::chrono::duration_cast<std::chrono::nanoseconds>( Duration ).count(),
+                 all.empty() ? 0.0 : static_cast<double>( totalCpuNs ) / all.size() );
+}
+
+void printMemory() {
+    std::printf( "\nmemory\n" );
+    std::printf( "  BusMsg             %6zu bytes (command inline buffer %zu)\n", sizeof( bus::BusMsg ), bus::CommandStorage::INLINE_SIZE );
+    std::printf( "  pool slot          %6zu bytes\n", sizeof( bus::BusMsgPool ) / bus::BusMsgPool::SIZE );
+    std::printf( "  mailbox entry      %6zu bytes\n", sizeof( bus::BusMsg* ) );
+    std::printf( "  mailbox per client %6zu bytes\n", sizeof( bus::Mailbox ) );
+    std::printf( "  timer wheel        %6zu bytes (%zu timers)\n", sizeof( bus::TimerWheel ), bus::TimerWheel::SIZE );
+}
+
+}  // namespace
+
+// Out of line, GCC flags malloc() or free() inlined next to a new or delete expression as a mismatch
+[[gnu::noinline]] void* operator new( std::size_t size ) {
+    g_heapAllocations.fetch_add( 1, std::memory_order_relaxed );
+    if( void* ptr = std::malloc( size ? size : 1 ) ) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete( void* ptr ) noexcept {
+    std::free( ptr );
+}
+
+void operator delete( void* ptr, std::size_t ) noexcept {
+    ::operator delete( ptr );
+}
+
+// The array forms too, or the library's ones pair with the replaced scalar ones
+void* operator new[]( std::size_t size ) {
+    return ::operator new( size );
+}
+
+void operator delete[]( void* ptr ) noexcept {
+    ::operator delete( ptr );
+}
+
+void operator delete[]( void* ptr, std::size_t ) noexcept {
+    ::operator delete( ptr );
+}
+
+int main() {
+    std::printf( "bus benchmark, %s mailbox\n", USE_LOCK_FREE_MAILBOX ? "lock-free ring" : "FreeRTOS queue" );
+
+    printMemory();
+    benchResolve();
+    benchDispatch();
+    benchNamedSend();
+    benchUnicast( 1 );
+    benchUnicast( bus::Mailbox::LENGTH );
+
+    std::printf( "\ngroup fan-out, latency of the regular members\n" );
+    std::printf( "%8s %6s %14s %10s %10s\n", "members", "slow", "deliveries/s", "p50 us", "p99 us" );
+    benchGroup( 4, false );
+    benchGroup( 4, true );
+    benchGroup( 32, false );
+
+    benchProducers();
+    benchRpc();
+
+    std::printf( "\ncontrol latency with a saturated bulk lane\n" );
+    std::printf( "%14s %10s %10s %10s %10s\n", "control sent", "delivered", "p50 us", "p99 us", "max us" );
+    benchPriority( bus::Priority::Bulk );
+    benchPriority( bus::Priority::Control );
+
+    std::printf( "\nbackpressure, producer -> slow consumer for 300 ms\n" );
+    std::printf( "%12s %10s %10s %10s %10s %10s\n", "policy", "sent", "received", "refused", "p50 us", "p99 us" );
+    benchBackpressure( "drop newest", bus::DeliveryPolicy::dropNewest() );
+    benchBackpressure( "drop oldest", bus::DeliveryPolicy::dropOldest() );
+    benchBackpressure( "fail fast", bus::DeliveryPolicy::failFast() );
+    benchBackpressure( "block 10", bus::DeliveryPolicy::block( 10 ) );
+
+    std::printf( "\nsensor updates of 4 keys -> slow consumer\n" );
+    std::printf( "%12s %10s %10s %10s %10s %10s %10s %10s\n", "topic", "sent", "received", "dropped", "pool peak", "p50 us", "p99 us", "ms" );
+    benchLatest( false );
+    benchLatest( true );
+
+    std::printf( "\nperiodic timers of 50..500 ms, 4 receivers, lateness after the deadline tick\n" );
+    std::printf( "%8s %12s %10s %10s %10s %8s %8s %10s %10s\n", "timers", "firings/s", "p50 us", "p99 us", "max us", "lost", "missed", "cpu %", "ns/firing" );
+    benchTimers( 1000 );
+    benchTimers( 4000 );
+    benchTimerTasks( 1000 );
+
+#if BUS_ENABLE_STATS
+    benchStats();
+#endif
+
+    return 0;
+}
@@ -0,0 +1,830 @@
+#include "Arena.h"
+#include "CrcStream.h"
+#include "InputStream.h"
+#include "Messages.h"
+#include "OutputStream.h"
+#include "RingStream.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <map>
+#include <new>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+using ClockType = std::chrono::steady_clock;
+
+std::atomic<uint64_t> g_heapAllocations{ 0 };
+volatile std::size_t g_sink = 0;  // keeps decoded payloads alive
+
+/**
+ * Item by item coding of the streams before the bulk paths, kept to compare
+ */
+template <typename T>
+__attribute__( ( noinline ) ) bool writeItemwise( streams::OutputBase& stream, const std::vector<T>& vec ) {
+    const streams::OutputBase::SizeType itemsCount = vec.size();
+    if( !stream.write( itemsCount ) ) {
+        return false;
+    }
+    for( const auto& item : vec ) {
+        if( !stream.write( item ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+__attribute__( ( noinline ) ) bool readItemwise( streams::InputBase& stream, std::vector<T>& vec ) {
+    streams::InputBase::SizeType itemsCount;
+    if( !stream.read( itemsCount ) ) {
+        return false;
+    }
+    vec = std::vector<T>( stream.begin<T>( itemsCount ), stream.end<T>() );
+    return vec.size() == itemsCount;
+}
+
+template <typename Container>
+__attribute__( ( noinline ) ) bool writeBulk( streams::OutputBase& stream, const Container& items ) {
+    return stream.write( items );
+}
+
+template <typename Container>
+__attribute__( ( noinline ) ) bool readBulk( streams::InputBase& stream, Container& items ) {
+    return stream.read( items );
+}
+
+/**
+ * @return ns per encode + decode of the payload
+ */
+template <typename Container, typename Write, typename Read>
+double measure( const Container& payload, Write write, Read read ) {
+    std::vector<char> buffer( payload.size() * sizeof( payload[0] ) + 64 );
+    Container decoded;
+    const std::size_t bytes = payload.size() * sizeof( payload[0] );
+    const int iterations = static_cast<int>( std::max<std::size_t>( 2000, ( 64u << 20 ) / ( bytes + 1 ) ) );
+
+    const auto start = ClockType::now();
+    for( int n = 0; n < iterations; ++n ) {
+        streams::ArrayOutputStream output( buffer.data(), buffer.size() );
+        streams::ArrayInputStream input( buffer.data(), buffer.size() );
+        if( !write( output, payload ) || !read( input, decoded ) || decoded.size() != payload.size() ) {
+            std::printf( "round trip failed\n" );
+            return 0;
+        }
+        g_sink += decoded.size();
+    }
+    return std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / iterations;
+}
+
+template <typename T>
+void benchVector( const char* name, std::size_t itemsCount ) {
+    std::vector<T> payload( itemsCount );
+    for( std::size_t i = 0; i < itemsCount; ++i ) {
+        payload[i] = static_cast<T>( i * 7 );
+    }
+
+    const double itemwiseNs = measure( payload, writeItemwise<T>, readItemwise<T> );
+    const double bulkNs = measure( payload, writeBulk<std::vector<T>>, readBulk<std::vector<T>> );
+    std::printf( "%-10s %8zu %14.1f %12.1f %10.1fx %12.0f\n",
+                 name,
+                 itemsCount,
+                 itemwiseNs,
+                 bulkNs,
+                 bulkNs ? itemwiseNs / bulkNs : 0.0,
+                 bulkNs ? itemsCount * sizeof( T ) / bulkNs * 1000 : 0.0 );
+}
+
+void benchString( std::size_t length ) {
+    const std::string payload( length, 'x' );
+
+    // The item by item string decoding went through the iterator as well
+    const double itemwiseNs = measure(
+        payload,
+        []( streams::OutputBase& stream, const std::string& str ) { return stream.write( str ); },
+        []( streams::InputBase& stream, std::string& str ) {
+            streams::InputBase::SizeType itemsCount;
+            if( !stream.read( itemsCount ) ) {
+                return false;
+            }
+            str = std::string( stream.begin<char>( itemsCount ), stream.end<char>() );
+            return str.size() == itemsCount;
+        } );
+    const double bulkNs = measure( payload, writeBulk<std::string>, readBulk<std::string> );
+    std::printf( "%-10s %8zu %14.1f %12.1f %10.1fx %12.0f\n",
+                 "string",
+                 length,
+                 itemwiseNs,
+                 bulkNs,
+                 bulkNs ? itemwiseNs / bulkNs : 0.0,
+                 bulkNs ? length / bulkNs * 1000 : 0.0 );
+}
+
+struct EncodingResult {
+    std::size_t bytes = 0;
+    double encodeNs = 0;
+    double decodeNs = 0;
+};
+
+/**
+ * Message ID and body, as messages::create() lays out a datagram
+ */
+template <typename Msg>
+EncodingResult measureEncoding( const Msg& msg, streams::IntegerEncoding encoding ) {
+    constexpr int Iterations = 1000000;
+
+    messages::BufferType buffer;
+    EncodingResult result;
+    auto start = ClockType::now();
+    for( int n = 0; n < Iterations; ++n ) {
+        streams::ArrayOutputStream output( buffer.data(), buffer.max_size() );
+        output.setIntegerEncoding( encoding );
+        const messages::MsgIdType id = Msg::ID;
+        if( !writeBulk( output, id ) || !writeBulk( output, msg ) ) {
+            std::printf( "encoding failed\n" );
+            return result;
+        }
+        result.bytes = output.dataSize();
+    }
+    result.encodeNs = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / Iterations;
+
+    start = ClockType::now();
+    for( int n = 0; n < Iterations; ++n ) {
+        streams::ArrayInputStream input( buffer.data(), result.bytes );
+        input.setIntegerEncoding( encoding );
+        messages::MsgIdType id = 0;
+        Msg decoded;
+        if( !readBulk( input, id ) || id != Msg::ID || !readBulk( input, decoded ) ) {
+            std::printf( "decoding failed\n" );
+            return result;
+        }
+        g_sink += input.size();
+    }
+    result.decodeNs = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / Iterations;
+    return result;
+}
+
+template <typename Msg>
+void benchEncoding( const char* name, const Msg& msg ) {
+    const auto fixed = measureEncoding( msg, streams::IntegerEncoding::Fixed );
+    const auto varint = measureEncoding( msg, streams::IntegerEncoding::Varint );
+    std::printf( "%-22s %8zu %8.1f %8.1f %10zu %8.1f %8.1f\n",
+                 name,
+                 fixed.bytes,
+                 fixed.encodeNs,
+                 fixed.decodeNs,
+                 varint.bytes,
+                 varint.encodeNs,
+                 varint.decodeNs );
+}
+
+/**
+ * Hand-written coding of the messages before the schemas, kept to compare
+ */
+struct HandDiscovery {
+    static const messages::MsgIdType ID = messages::Discovery::ID;
+
+    std::uint32_t devId;
+
+    inline bool write( streams::OutputBase& stream ) const {
+        return stream.write( devId );
+    }
+
+    inline bool read( streams::InputBase& stream ) {
+        return stream.read( devId );
+    }
+};
+
+struct HandTemperature {
+    static const messages::MsgIdType ID = messages::Temperature::ID;
+
+    std::uint64_t sensorId;
+    float value;
+
+    inline bool write( streams::OutputBase& stream ) const {
+        return stream.write( sensorId ) && stream.write( value );
+    }
+
+    inline bool read( streams::InputBase& stream ) {
+        return stream.read( sensorId ) && stream.read( value );
+    }
+};
+
+struct HandBusBatch {
+    static const messages::MsgIdType ID = messages::BusBatch::ID;
+
+    std::uint32_t origin;
+
+    inline bool write( streams::OutputBase& stream ) const {
+        return stream.write( origin );
+    }
+
+    inline bool read( streams::InputBase& stream ) {
+        return stream.read( origin );
+    }
+};
+
+template <typename Msg, typename Hand>
+void benchSchema( const char* name, const Msg& msg, const Hand& hand ) {
+    const auto generated = measureEncoding( msg, streams::IntegerEncoding::Fixed );
+    const auto written = measureEncoding( hand, streams::IntegerEncoding::Fixed );
+    if( generated.bytes != written.bytes || generated.bytes > messages::maxMessageSize<Msg>() ) {
+        std::printf( "%s: wire format differs\n", name );
+        return;
+    }
+    std::printf( "%-22s %8zu %8zu %8.1f %8.1f %10.1f %8.1f\n",
+                 name,
+                 generated.bytes,
+                 messages::maxMessageSize<Msg>(),
+                 written.encodeNs,
+                 written.decodeNs,
+                 generated.encodeNs,
+                 generated.decodeNs );
+}
+
+/**
+ * Small readings with a count, the case the varint encoding is meant for
+ */
+struct Readings {
+    static const messages::MsgIdType ID = 0x1d0c5e77;
+
+    std::vector<std::uint16_t> values;
+
+    bool write( streams::OutputBase& stream ) const {
+        return stream.write( values );
+    }
+
+    bool read( streams::InputBase& stream ) {
+        return stream.read( values );
+    }
+};
+
+/**
+ * @return bytes and ns per round trip of the container
+ */
+template <typename Container>
+std::pair<std::size_t, double> measureContainer( const Container& payload, streams::ContainerFormat format ) {
+    constexpr int Iterations = 20000;
+
+    std::vector<char> buffer( 64 * 1024 );
+    std::size_t bytes = 0;
+    const auto start = ClockType::now();
+    for( int n = 0; n < Iterations; ++n ) {
+        streams::ArrayOutputStream output( buffer.data(), buffer.size() );
+        output.setContainerFormat( format );
+        Container decoded;
+        if( !writeBulk( output, payload ) ) {
+            std::printf( "encoding failed\n" );
+            break;
+        }
+        streams::ArrayInputStream input( buffer.data(), output.dataSize() );
+        if( !readBulk( input, decoded ) || decoded.size() != payload.size() ) {
+            std::printf( "decoding failed\n" );
+            break;
+        }
+        bytes = output.dataSize();
+        g_sink += decoded.size();
+    }
+    return { bytes, std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / Iterations };
+}
+
+template <typename Container>
+void benchContainer( const char* name, const Container& payload ) {
+    const auto markers = measureContainer( payload, streams::ContainerFormat::Markers );
+    const auto counted = measureContainer( payload, streams::ContainerFormat::Counted );
+    std::printf( "%-22s %10zu %10.0f %10zu %10.0f\n", name, markers.first, markers.second, counted.first, counted.second );
+}
+
+/**
+ * Datagram of a UDP handler: a name, a blob and readings
+ */
+struct Payload {
+    std::string name;
+    std::vector<std::uint8_t> blob;
+    std::vector<std::uint16_t> readings;
+
+    bool write( streams::OutputBase& stream ) const {
+        return stream.write( name ) && stream.write( blob ) && stream.write( readings );
+    }
+};
+
+struct PayloadView {
+    std::string_view name;
+    streams::ByteView blob;
+    streams::ArrayView<std::uint16_t> readings;
+};
+
+template <typename Name, typename Blob, typename Readings>
+__attribute__( ( noinline ) ) bool readPayload( streams::InputBase& stream, Name& name, Blob& blob, Readings& readings ) {
+    return stream.read( name ) && stream.read( blob ) && stream.read( readings );
+}
+
+/**
+ * Decode the payload and look at every field, as a handler inspecting it would
+ */
+template <typename Name, typename Blob, typename Readings>
+void benchPayloadDecode( const char* name, const std::vector<char>& datagram ) {
+    constexpr int Iterations = 1000000;
+
+    std::vector<char> buffer( datagram );
+    const auto allocationsBefore = g_heapAllocations.load();
+    const auto start = ClockType::now();
+    for( int n = 0; n < Iterations; ++n ) {
+        streams::ArrayInputStream stream( buffer.data(), buffer.size() );
+        Name payloadName;
+        Blob blob;
+        Readings readings;
+        if( !readPayload( stream, payloadName, blob, readings ) ) {
+            std::printf( "decoding failed\n" );
+            return;
+        }
+        std::size_t sum = payloadName.size() + blob[blob.size() - 1];
+        for( auto reading : readings ) {
+            sum += reading;
+        }
+        g_sink += sum;
+    }
+    const double ns = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / Iterations;
+    std::printf( "%-10s %10.1f %12.2f\n", name, ns, static_cast<double>( g_heapAllocations.load() - allocationsBefore ) / Iterations );
+}
+
+/**
+ * Frame of a serial or TCP transport: a sequence number, a name and a blob of ( seq & 0xff ) bytes
+ */
+constexpr std::uint32_t StreamFrames = 20000;
+constexpr std::uint32_t OversizedFrame = 5000;  // longer than the ring, skipped by the reader
+
+bool writeFrame( streams::OutputBase& stream, std::uint32_t seq, std::size_t blobSize ) {
+    static const std::vector<std::uint8_t> blobs = [] {
+        std::vector<std::uint8_t> bytes( 256 * 2048 );
+        for( std::size_t i = 0; i < bytes.size(); ++i ) {
+            bytes[i] = static_cast<std::uint8_t>( i / 2048 );
+        }
+        return bytes;
+    }();
+    const std::string name = "sensor-" + std::to_string( seq % 97 );
+    const streams::ByteView blob( reinterpret_cast<const char*>( &blobs[( seq & 0xff ) * 2048] ), blobSize );
+    return stream.write( seq ) && stream.write( std::string_view( name ) ) && stream.write( blob );
+}
+
+/**
+ * @return frames decoded and verified, the next expected sequence number is advanced past the oversized frame
+ */
+std::uint32_t decodeFrames( streams::RingInputStream& input, std::uint32_t& expected ) {
+    std::uint32_t frames = 0;
+    while( input.nextFrame() ) {
+        std::uint32_t seq = 0;
+        std::string_view name;
+        streams::ByteView blob;
+        if( expected == OversizedFrame ) {
+            ++expected;
+        }
+        if( !input.read( seq ) || !input.read( name ) || !input.read( blob ) || input.size() || seq != expected ||
+            name != "sensor-" + std::to_string( seq % 97 ) ) {
+            return frames;
+        }
+        for( const auto byte : blob ) {
+            if( byte != ( seq & 0xff ) ) {
+                return frames;
+            }
+        }
+        ++expected;
+        ++frames;
+    }
+    return frames;
+}
+
+/**
+ * Frames fed into a 1 KiB ring in random fragments of 1..maxFragment bytes, as a transport receives them
+ */
+void benchRing( const std::vector<char>& wire, std::uint32_t maxFragment ) {
+    std::array<char, 1024> storage;
+    streams::RingBuffer ring( storage.data(), storage.size() );
+    streams::RingInputStream input( ring );
+    std::mt19937 random( maxFragment );
+    std::uniform_int_distribution<std::uint32_t> fragments( 1, maxFragment );
+
+    std::uint32_t frames = 0;
+    std::uint32_t expected = 0;
+    std::size_t fed = 0;
+    std::size_t fragmentsCount = 0;
+    const auto start = ClockType::now();
+    while( fed < wire.size() ) {
+        std::uint32_t fragment = std::min<std::size_t>( fragments( random ), wire.size() - fed );
+        ++fragmentsCount;
+        while( fragment ) {
+            streams::RingBuffer::SizeType spanSize = 0;
+            auto span = ring.writeSpan( spanSize );
+            const auto chunk = std::min( fragment, spanSize );
+            if( !chunk ) {
+                std::printf( "ring stalled\n" );
+                return;
+            }
+            std::memcpy( span, wire.data() + fed, chunk );  // recv() into the ring
+            ring.produce( chunk );
+            fed += chunk;
+            fragment -= chunk;
+            frames += decodeFrames( input, expected );
+        }
+    }
+    const double elapsedSec = std::chrono::duration<double>( ClockType::now() - start ).count();
+    const bool isValid = frames == StreamFrames - 1 && input.skippedFrames() == 1 && !ring.size();
+    std::printf( "%-12u %10zu %10u %8u %10.1f %8s\n",
+                 maxFragment,
+                 fragmentsCount,
+                 frames,
+                 input.skippedFrames(),
+                 wire.size() / elapsedSec / 1e6,
+                 isValid ? "ok" : "FAILED" );
+}
+
+/**
+ * Packet of strings and node based containers, every one of them allocates when decoded on the heap
+ */
+struct Inventory {
+    std::string name;
+    std::list<std::string> tags;
+    std::map<std::string, std::int32_t> counters;
+    std::vector<std::uint16_t> readings;
+
+    static constexpr auto fields() {
+        return std::make_tuple( &Inventory::name, &Inventory::tags, &Inventory::counters, &Inventory::readings );
+    }
+};
+
+struct ArenaInventory {
+    streams::ArenaString name;
+    streams::ArenaList<streams::ArenaString> tags;
+    streams::ArenaMap<streams::ArenaString, std::int32_t> counters;
+    streams::ArenaVector<std::uint16_t> readings;
+
+    explicit ArenaInventory( streams::Arena& arena )
+    : name( streams::ArenaAllocator<char>( arena ) )
+    , tags( streams::ArenaAllocator<char>( arena ) )
+    , counters( streams::ArenaAllocator<char>( arena ) )
+    , readings( streams::ArenaAllocator<char>( arena ) ) {}
+
+    static constexpr auto fields() {
+        return std::make_tuple( &ArenaInventory::name, &ArenaInventory::tags, &ArenaInventory::counters, &ArenaInventory::readings );
+    }
+};
+
+/**
+ * Decode and drop of the packet by a handler, on the heap and in an arena of budget bytes
+ */
+void benchArena( const std::vector<char>& packet, streams::Arena::SizeType budget ) {
+    constexpr int Iterations = 100000;
+
+    auto allocations = g_heapAllocations.load();
+    auto start = ClockType::now();
+    for( int n = 0; n < Iterations; ++n ) {
+        streams::ArrayInputStream input( const_cast<char*>( packet.data() ), packet.size() );
+        Inventory inventory;
+        if( !input.read( inventory ) ) {
+            std::printf( "heap decode failed\n" );
+            return;
+        }
+        g_sink += inventory.tags.size();
+    }
+    const double heapNs = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / Iterations;
+    const double heapAllocations = static_cast<double>( g_heapAllocations.load() - allocations ) / Iterations;
+
+    std::vector<char> storage( budget );
+    streams::Arena arena( storage.data(), budget );
+    int rejected = 0;
+    allocations = g_heapAllocations.load();
+    start = ClockType::now();
+    for( int n = 0; n < Iterations; ++n ) {
+        {
+            streams::ArrayInputStream input( const_cast<char*>( packet.data() ), packet.size() );
+            input.setArena( &arena );
+            ArenaInventory inventory( arena );
+            if( !input.read( inventory ) ) {
+                ++rejected;
+            }
+            g_sink += inventory.tags.size();
+        }
+        arena.release();
+    }
+    const double arenaNs = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / Iterations;
+    const double arenaAllocations = static_cast<double>( g_heapAllocations.load() - allocations ) / Iterations;
+
+    std::printf( "%8u %10.0f %12.1f %10.0f %12.1f %10u %10s\n",
+                 budget,
+                 heapNs,
+                 heapAllocations,
+                 arenaNs,
+                 arenaAllocations,
+                 arena.highWater(),
+                 rejected ? ( rejected == Iterations ? "rejected" : "SOME" ) : "decoded" );
+}
+
+/**
+ * Bit by bit CRC-16/ARC, the way onewire::crc16 computes it without a table, kept to compare
+ */
+std::uint16_t crc16Bitwise( std::uint16_t crc, const void* data, std::size_t dataSize ) {
+    auto bytes = static_cast<const std::uint8_t*>( data );
+    while( dataSize-- ) {
+        crc ^= *bytes++;
+        for( int bit = 0; bit < 8; ++bit ) {
+            crc = crc & 1 ? ( crc >> 1 ) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+template <typename Update>
+double measureCrc( const std::vector<char>& data, Update update ) {
+    constexpr int Iterations = 2000;
+    const auto start = ClockType::now();
+    for( int n = 0; n < Iterations; ++n ) {
+        g_sink += update( data.data(), data.size() );
+    }
+    return data.size() * static_cast<double>( Iterations ) / std::chrono::duration<double>( ClockType::now() - start ).count() / 1e6;
+}
+
+template <typename Crc>
+bool writeChecked( streams::OutputBase& output, streams::ByteView payload ) {
+    streams::CrcOutputStream<Crc> checked( output );
+    return checked.write( payload ) && checked.writeTrailer();
+}
+
+template <typename Crc>
+bool readChecked( streams::InputBase& input ) {
+    streams::CrcInputStream<Crc> checked( input );
+    streams::ByteView payload;
+    return checked.read( payload ) && checked.verifyTrailer();
+}
+
+/**
+ * @return MB/s of a payload round trip through the CRC streams, the trailer written and verified
+ */
+template <typename Crc>
+double measureCrcStreams( const std::vector<char>& data, bool& isCorruptionDetected ) {
+    constexpr int Iterations = 2000;
+    std::vector<char> buffer( data.size() + 16 );
+    const streams::ByteView payload( data.data(), data.size() );
+    const auto start = ClockType::now();
+    for( int n = 0; n < Iterations; ++n ) {
+        streams::ArrayOutputStream output( buffer.data(), buffer.size() );
+        if( !writeChecked<Crc>( output, payload ) ) {
+            return 0;
+        }
+        streams::ArrayInputStream message( buffer.data(), output.dataSize() );
+        if( !readChecked<Crc>( message ) ) {
+            std::printf( "checksum mismatch\n" );
+            return 0;
+        }
+    }
+    const double mbps = data.size() * static_cast<double>( Iterations ) / std::chrono::duration<double>( ClockType::now() - start ).count() / 1e6;
+
+    streams::ArrayOutputStream output( buffer.data(), buffer.size() );
+    writeChecked<Crc>( output, payload );
+    buffer[data.size() / 2] ^= 0x10;
+    streams::ArrayInputStream message( buffer.data(), output.dataSize() );
+    isCorruptionDetected = !readChecked<Crc>( message );
+    return mbps;
+}
+
+void benchCrc( std::size_t dataSize ) {
+    std::vector<char> data( dataSize );
+    for( std::size_t i = 0; i < dataSize; ++i ) {
+        data[i] = static_cast<char>( i * 131 + 7 );
+    }
+    const double bitwise = measureCrc( data, []( const char* bytes, std::size_t size ) { return crc16Bitwise( 0, bytes, size ); } );
+    const double crc16 = measureCrc( data, []( const char* bytes, std::size_t size ) { return crc::calculate<crc::Crc16>( bytes, size ); } );
+    const double crc32 = measureCrc( data, []( const char* bytes, std::size_t size ) { return crc::calculate<crc::Crc32>( bytes, size ); } );
+    const double plain = measure( std::vector<std::uint8_t>( data.begin(), data.end() ),
+                                  []( streams::OutputBase& stream, const std::vector<std::uint8_t>& vec ) { return stream.write( vec ); },
+                                  []( streams::InputBase& stream, std::vector<std::uint8_t>& vec ) { return stream.read( vec ); } );
+    bool isDetected16 = false;
+    bool isDetected32 = false;
+    const double streams16 = measureCrcStreams<crc::Crc16>( data, isDetected16 );
+    const double streams32 = measureCrcStreams<crc::Crc32>( data, isDetected32 );
+    std::printf( "%8zu %10.0f %10.0f %10.0f %12.0f %10.0f %10.0f %10s\n",
+                 dataSize,
+                 bitwise,
+                 crc16,
+                 crc32,
+                 dataSize / plain * 1e3,
+                 streams16,
+                 streams32,
+                 isDetected16 && isDetected32 ? "detected" : "MISSED" );
+}
+
+/**
+ * messages::Temperature with its ID, as messages::create() lays it out, through each kind of stream
+ */
+template <typename Writer>
+__attribute__( ( noinline ) ) std::size_t encodeTemperature( char* buffer, std::size_t bufferSize, const messages::Temperature& msg ) {
+    Writer output( buffer, bufferSize );
+    const messages::MsgIdType id = messages::Temperature::ID;
+    return output.write( id ) && output.write( msg ) ? output.dataSize() : 0;
+}
+
+__attribute__( ( noinline ) ) bool encodeTemperatureErased( streams::OutputBase& output, const messages::Temperature& msg ) {
+    const messages::MsgIdType id = messages::Temperature::ID;
+    return output.write( id ) && output.write( msg );
+}
+
+template <typename Reader>
+__attribute__( ( noinline ) ) bool decodeTemperature( char* buffer, std::size_t bufferSize, messages::Temperature& msg ) {
+    Reader input( buffer, bufferSize );
+    messages::MsgIdType id = 0;
+    return input.read( id ) && id == messages::Temperature::ID && input.read( msg );
+}
+
+__attribute__( ( noinline ) ) bool decodeTemperatureErased( streams::InputBase& input, messages::Temperature& msg ) {
+    messages::MsgIdType id = 0;
+    return input.read( id ) && id == messages::Temperature::ID && input.read( msg );
+}
+
+template <typename Encode, typename Decode>
+void benchDispatch( const char* name, Encode encode, Decode decode ) {
+    constexpr int Iterations = 10000000;
+
+    messages::MsgBufferType<messages::Temperature> buffer;
+    std::size_t bytes = 0;
+    auto start = ClockType::now();
+    for( int n = 0; n < Iterations; ++n ) {
+        bytes = encode( buffer.data(), buffer.size(), messages::Temperature{ static_cast<std::uint64_t>( n ), 21.5f } );
+        g_sink += bytes;
+    }
+    const double encodeNs = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / Iterations;
+
+    messages::Temperature msg;
+    start = ClockType::now();
+    for( int n = 0; n < Iterations; ++n ) {
+        if( !decode( buffer.data(), bytes, msg ) ) {
+            std::printf( "decoding failed\n" );
+            return;
+        }
+        g_sink += msg.sensorId;
+    }
+    const double decodeNs = std::chrono::duration<double, std::nano>( ClockType::now() - start ).count() / Iterations;
+    std::printf( "%-34s %8zu %8.2f %8.2f\n", name, bytes, encodeNs, decodeNs );
+}
+
+}  // namespace
+
+// Out of line, GCC flags malloc() or free() inlined next to a new or delete expression as a mismatch
+[[gnu::noinline]] void* operator new( std::size_t size ) {
+    g_heapAllocations.fetch_add( 1, std::memory_order_relaxed );
+    if( void* ptr = std::malloc( size ? size : 1 ) ) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete( void* ptr ) noexcept {
+    std::free( ptr );
+}
+
+void operator delete( void* ptr, std::size_t ) noexcept {
+    ::operator delete( ptr );
+}
+
+// The array forms too, or the library's ones pair with the replaced scalar ones
+void* operator new[]( std::size_t size ) {
+    return ::operator new( size );
+}
+
+void operator delete[]( void* ptr ) noexcept {
+    ::operator delete( ptr );
+}
+
+void operator delete[]( void* ptr, std::size_t ) noexcept {
+    ::operator delete( ptr );
+}
+
+int main() {
+    std::printf( "streams round trip ( write + read ), ArrayOutputStream -> ArrayInputStream\n" );
+    std::printf( "%-10s %8s %14s %12s %11s %12s\n", "payload", "items", "itemwise ns", "bulk ns", "speedup", "bulk MB/s" );
+    for( std::size_t itemsCount : { 1, 16, 256, 4096 } ) {
+        benchVector<uint8_t>( "u8", itemsCount );
+    }
+    for( std::size_t itemsCount : { 1, 16, 256, 4096 } ) {
+        benchVector<uint16_t>( "u16", itemsCount );
+    }
+    for( std::size_t itemsCount : { 1, 16, 256, 4096 } ) {
+        benchVector<float>( "float", itemsCount );
+    }
+    for( std::size_t length : { 1, 16, 256, 4096 } ) {
+        benchString( length );
+    }
+
+    std::printf( "\ninteger encoding, message ID + body\n" );
+    std::printf( "%-22s %8s %8s %8s %10s %8s %8s\n", "message", "fixed B", "enc ns", "dec ns", "varint B", "enc ns", "dec ns" );
+    benchEncoding( "Discovery", messages::Discovery{ 0x00a1b2c3 } );
+    benchEncoding( "Temperature", messages::Temperature{ 0x28ff64a1c2160352ull, 21.5f } );
+    Readings readings;
+    for( std::uint16_t i = 0; i < 16; ++i ) {
+        readings.values.push_back( static_cast<std::uint16_t>( i * 5 ) );
+    }
+    benchEncoding( "16 readings < 128", readings );
+
+    std::printf( "\nschema coding, message ID + body, fixed integers\n" );
+    std::printf( "%-22s %8s %8s %8s %8s %10s %8s\n", "message", "bytes", "max B", "hand enc", "dec ns", "schema enc", "dec ns" );
+    benchSchema( "Discovery", messages::Discovery{ 0x00a1b2c3 }, HandDiscovery{ 0x00a1b2c3 } );
+    benchSchema( "Temperature", messages::Temperature{ 0x28ff64a1c2160352ull, 21.5f }, HandTemperature{ 0x28ff64a1c2160352ull, 21.5f } );
+    benchSchema( "BusBatch", messages::BusBatch{ 0x00a1b2c3 }, HandBusBatch{ 0x00a1b2c3 } );
+
+    std::list<std::int32_t> ints;
+    std::list<std::string> strings;
+    std::set<std::int32_t> intSet;
+    std::map<std::int32_t, std::int32_t> intMap;
+    std::map<std::string, std::int32_t> stringMap;
+    for( std::int32_t i = 0; i < 64; ++i ) {
+        ints.push_back( i );
+        strings.push_back( "sensor-" + std::to_string( i ) );
+        intSet.insert( i );
+        intMap.emplace( i, i * 10 );
+        stringMap.emplace( "sensor-" + std::to_string( i ), i );
+    }
+    std::printf( "\ncontainers of 64 elements, round trip\n" );
+    std::printf( "%-22s %10s %10s %10s %10s\n", "container", "markers B", "ns", "counted B", "ns" );
+    benchContainer( "list<int32_t>", ints );
+    benchContainer( "set<int32_t>", intSet );
+    benchContainer( "map<int32_t, int32_t>", intMap );
+    benchContainer( "list<string>", strings );
+    benchContainer( "map<string, int32_t>", stringMap );
+
+    Payload payload{ "living-room-dimmer-0042", std::vector<std::uint8_t>( 64, 0x5a ), std::vector<std::uint16_t>( 16, 215 ) };
+    std::vector<char> datagram( 512 );
+    streams::ArrayOutputStream output( datagram.data(), datagram.size() );
+    payload.write( output );
+    datagram.resize( output.dataSize() );
+    std::printf( "\ndecode of a %zu byte datagram: 23 char name, 64 byte blob, 16 readings\n", datagram.size() );
+    std::printf( "%-10s %10s %12s\n", "fields", "ns", "allocs" );
+    benchPayloadDecode<std::string, std::vector<std::uint8_t>, std::vector<std::uint16_t>>( "copies", datagram );
+    benchPayloadDecode<std::string_view, streams::ByteView, streams::ArrayView<std::uint16_t>>( "views", datagram );
+
+    std::printf( "\nTemperature with its ID, virtual vs inline byte access\n" );
+    std::printf( "%-34s %8s %8s %8s\n", "stream", "bytes", "enc ns", "dec ns" );
+    benchDispatch(
+        "OutputBase& / InputBase&",
+        []( char* buffer, std::size_t size, const messages::Temperature& msg ) {
+            streams::ArrayOutputStream output( buffer, size );
+            return encodeTemperatureErased( output, msg ) ? static_cast<std::size_t>( output.dataSize() ) : 0;
+        },
+        []( char* buffer, std::size_t size, messages::Temperature& msg ) {
+            streams::ArrayInputStream input( buffer, size );
+            return decodeTemperatureErased( input, msg );
+        } );
+    benchDispatch( "ArrayOutputStream / ArrayInputStream", encodeTemperature<streams::ArrayOutputStream>, decodeTemperature<streams::ArrayInputStream> );
+    benchDispatch( "ArrayWriter / ArrayReader", encodeTemperature<streams::ArrayWriter>, decodeTemperature<streams::ArrayReader> );
+
+    Inventory inventory;
+    inventory.name = "living-room-dimmer-0042";
+    for( int i = 0; i < 8; ++i ) {
+        inventory.tags.push_back( "living-room-tag-" + std::to_string( 10 + i ) );
+        inventory.counters.emplace( "counter-of-sensor-" + std::to_string( 10 + i ), i );
+    }
+    inventory.readings.assign( 16, 215 );
+    std::vector<char> packet( 1024 );
+    streams::ArrayOutputStream packetOutput( packet.data(), packet.size() );
+    packetOutput.write( inventory );
+    packet.resize( packetOutput.dataSize() );
+    std::printf( "\ndecode of a %zu byte packet: name, 8 tags, 8 counters, 16 readings, heap vs arena\n", packet.size() );
+    std::printf( "%8s %10s %12s %10s %12s %10s %10s\n", "budget", "heap ns", "heap allocs", "arena ns", "heap allocs", "arena B", "result" );
+    benchArena( packet, 2048 );
+    benchArena( packet, 1024 );
+    benchArena( packet, 256 );
+
+    std::printf( "\nchecksums, MB/s, streams: payload written with the trailer and read back with the check\n" );
+    std::printf( "%8s %10s %10s %10s %12s %10s %10s %10s\n", "bytes", "bitwise16", "crc16", "crc32", "plain strm", "crc16 strm", "crc32 strm", "bit flip" );
+    for( std::size_t dataSize : { 64, 512, 4096 } ) {
+        benchCrc( dataSize );
+    }
+
+    std::vector<char> wireStorage( 8 << 20 );
+    streams::RingBuffer wireRing( wireStorage.data(), wireStorage.size() );
+    streams::RingOutputStream wireOutput( wireRing );
+    for( std::uint32_t seq = 0; seq < StreamFrames; ++seq ) {
+        const std::size_t blobSize = OversizedFrame == seq ? 2000 : ( seq * 37 ) % 200;
+        if( !wireOutput.beginFrame() || !writeFrame( wireOutput, seq, blobSize ) || !wireOutput.endFrame() ) {
+            std::printf( "framing failed\n" );
+            return 1;
+        }
+    }
+    streams::RingBuffer::SizeType wireSize = 0;
+    const auto wireData = wireRing.readSpan( wireSize );
+    const std::vector<char> wire( wireData, wireData + wireSize );
+    std::printf( "\n%u frames, %zu bytes, decoded with views from a 1 KiB ring in random fragments\n", StreamFrames, wire.size() );
+    std::printf( "%-12s %10s %10s %8s %10s %8s\n", "fragment <=", "fragments", "frames", "skipped", "MB/s", "check" );
+    for( std::uint32_t maxFragment : { 1, 7, 64, 512, 1460 } ) {
+        benchRing( wire, maxFragment );
+    }
+    return 0;
+}
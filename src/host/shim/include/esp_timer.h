@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Microseconds since the process start
+ */
+int64_t esp_timer_get_time( void );
+
+#ifdef __cplusplus
+}
+#endif
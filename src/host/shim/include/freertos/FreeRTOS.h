@@ -0,0 +1,22 @@
+#pragma once
+
+/**
+ * @brief Host (Linux) stand-in for the subset of FreeRTOS used by the components.
+ *
+ * One tick is one millisecond, tasks are std::thread's.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "portmacro.h"
+
+#define configTICK_RATE_HZ 1000
+
+#define pdFALSE ( (BaseType_t)0 )
+#define pdTRUE ( (BaseType_t)1 )
+#define pdPASS ( pdTRUE )
+#define pdFAIL ( pdFALSE )
+
+#define BIT0 0x00000001
+#define BIT1 0x00000002
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex( void );
+SemaphoreHandle_t xSemaphoreCreateCounting( UBaseType_t uxMaxCount, UBaseType_t uxInitialCount );
+SemaphoreHandle_t xSemaphoreCreateBinary( void );
+BaseType_t xSemaphoreTake( SemaphoreHandle_t xSemaphore, TickType_t xTicksToWait );
+BaseType_t xSemaphoreGive( SemaphoreHandle_t xSemaphore );
+void vSemaphoreDelete( SemaphoreHandle_t xSemaphore );
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct TaskControlBlock* TaskHandle_t;
+typedef void ( *TaskFunction_t )( void* );
+
+BaseType_t xTaskCreate( TaskFunction_t pxTaskCode,
+                        const char* pcName,
+                        uint32_t usStackDepth,
+                        void* pvParameters,
+                        UBaseType_t uxPriority,
+                        TaskHandle_t* pxCreatedTask );
+void vTaskDelete( TaskHandle_t xTaskToDelete );
+void vTaskDelay( TickType_t xTicksToDelay );
+TickType_t xTaskGetTickCount( void );
+TaskHandle_t xTaskGetCurrentTaskHandle( void );
+
+BaseType_t xTaskNotifyGive( TaskHandle_t xTaskToNotify );
+uint32_t ulTaskNotifyTake( BaseType_t xClearCountOnExit, TickType_t xTicksToWait );
+
+#ifdef __cplusplus
+}
+#endif
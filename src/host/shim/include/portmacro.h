@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef TickType_t portTickType;
+
+#define portMAX_DELAY ( (TickType_t)0xffffffffUL )
+#define portTICK_PERIOD_MS ( (TickType_t)1 )
+#define portTICK_RATE_MS portTICK_PERIOD_MS
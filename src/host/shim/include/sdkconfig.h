@@ -0,0 +1,7 @@
+#pragma once
+
+/**
+ * @brief Host build configuration, replaces the one generated by the ESP IDF build.
+ */
+
+#define CONFIG_FREERTOS_HZ 1000
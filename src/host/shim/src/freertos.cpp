@@ -0,0 +1,203 @@
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Items are copied into storage allocated once, as FreeRTOS does
+struct QueueDefinition {
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::vector<char> storage;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t head = 0;
+    UBaseType_t count = 0;
+
+    QueueDefinition( UBaseType_t _length, UBaseType_t _itemSize )
+    : storage( _length * _itemSize )
+    , length( _length )
+    , itemSize( _itemSize ) {}
+};
+
+struct TaskControlBlock {
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t notifyValue = 0;
+};
+
+namespace {
+
+using ClockType = std::chrono::steady_clock;
+
+const ClockType::time_point g_startTime = ClockType::now();
+
+template <typename Predicate>
+bool waitFor( std::condition_variable& cv, std::unique_lock<std::mutex>& lock, TickType_t ticks, Predicate pred ) {
+    if( ticks == portMAX_DELAY ) {
+        cv.wait( lock, pred );
+        return true;
+    }
+    if( !ticks ) {
+        return pred();  // a poll, FreeRTOS doesn't block either
+    }
+    return cv.wait_for( lock, std::chrono::milliseconds( ticks * portTICK_PERIOD_MS ), pred );
+}
+
+TaskControlBlock* currentTask() {
+    // Control blocks outlive their threads, other tasks may still hold the handle
+    static std::mutex registryMutex;
+    static std::vector<std::unique_ptr<TaskControlBlock>> registry;
+    thread_local TaskControlBlock* tcb = nullptr;
+    if( !tcb ) {
+        std::lock_guard<std::mutex> lock( registryMutex );
+        registry.emplace_back( new TaskControlBlock() );
+        tcb = registry.back().get();
+    }
+    return tcb;
+}
+
+}  // namespace
+
+QueueHandle_t xQueueCreate( UBaseType_t uxQueueLength, UBaseType_t uxItemSize ) {
+    return new QueueDefinition( uxQueueLength, uxItemSize );
+}
+
+void vQueueDelete( QueueHandle_t xQueue ) {
+    delete xQueue;
+}
+
+BaseType_t xQueueSend( QueueHandle_t xQueue, const void* pvItemToQueue, TickType_t xTicksToWait ) {
+    std::unique_lock<std::mutex> lock( xQueue->mutex );
+    if( !waitFor( xQueue->notFull, lock, xTicksToWait, [xQueue] { return xQueue->count < xQueue->length; } ) ) {
+        return pdFALSE;
+    }
+    if( pvItemToQueue && xQueue->itemSize ) {
+        const UBaseType_t tail = ( xQueue->head + xQueue->count ) % xQueue->length;
+        std::memcpy( &xQueue->storage[tail * xQueue->itemSize], pvItemToQueue, xQueue->itemSize );
+    }
+    ++xQueue->count;
+    xQueue->notEmpty.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive( QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait ) {
+    std::unique_lock<std::mutex> lock( xQueue->mutex );
+    if( !waitFor( xQueue->notEmpty, lock, xTicksToWait, [xQueue] { return xQueue->count != 0; } ) ) {
+        return pdFALSE;
+    }
+    if( pvBuffer && xQueue->itemSize ) {
+        std::memcpy( pvBuffer, &xQueue->storage[xQueue->head * xQueue->itemSize], xQueue->itemSize );
+    }
+    xQueue->head = ( xQueue->head + 1 ) % xQueue->length;
+    --xQueue->count;
+    xQueue->notFull.notify_one();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting( QueueHandle_t xQueue ) {
+    std::lock_guard<std::mutex> lock( xQueue->mutex );
+    return xQueue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex( void ) {
+    return xSemaphoreCreateCounting( 1, 1 );
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting( UBaseType_t uxMaxCount, UBaseType_t uxInitialCount ) {
+    auto semaphore = xQueueCreate( uxMaxCount, 0 );
+    for( UBaseType_t i = 0; i < uxInitialCount; ++i ) {
+        xQueueSend( semaphore, nullptr, 0 );
+    }
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary( void ) {
+    return xSemaphoreCreateCounting( 1, 0 );
+}
+
+BaseType_t xSemaphoreTake( SemaphoreHandle_t xSemaphore, TickType_t xTicksToWait ) {
+    return xQueueReceive( xSemaphore, nullptr, xTicksToWait );
+}
+
+BaseType_t xSemaphoreGive( SemaphoreHandle_t xSemaphore ) {
+    return xQueueSend( xSemaphore, nullptr, 0 );
+}
+
+void vSemaphoreDelete( SemaphoreHandle_t xSemaphore ) {
+    vQueueDelete( xSemaphore );
+}
+
+BaseType_t xTaskCreate( TaskFunction_t pxTaskCode,
+                        const char* pcName,
+                        uint32_t usStackDepth,
+                        void* pvParameters,
+                        UBaseType_t uxPriority,
+                        TaskHandle_t* pxCreatedTask ) {
+    // The promise moves into the thread, nothing on this stack is touched after the return
+    std::promise<TaskHandle_t> started;
+    auto handle = started.get_future();
+    std::thread( [pxTaskCode, pvParameters, started = std::move( started )]() mutable {
+        started.set_value( currentTask() );
+        pxTaskCode( pvParameters );
+    } ).detach();
+
+    if( pxCreatedTask ) {
+        *pxCreatedTask = handle.get();
+    }
+    else {
+        handle.wait();
+    }
+    return pdPASS;
+}
+
+void vTaskDelete( TaskHandle_t xTaskToDelete ) {
+    // Host tasks end by returning from the task function
+}
+
+void vTaskDelay( TickType_t xTicksToDelay ) {
+    std::this_thread::sleep_for( std::chrono::milliseconds( xTicksToDelay * portTICK_PERIOD_MS ) );
+}
+
+TickType_t xTaskGetTickCount( void ) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>( ClockType::now() - g_startTime );
+    return static_cast<TickType_t>( elapsed.count() / portTICK_PERIOD_MS );
+}
+
+int64_t esp_timer_get_time( void ) {
+    return std::chrono::duration_cast<std::chrono::microseconds>( ClockType::now() - g_startTime ).count();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle( void ) {
+    return currentTask();
+}
+
+BaseType_t xTaskNotifyGive( TaskHandle_t xTaskToNotify ) {
+    {
+        std::lock_guard<std::mutex> lock( xTaskToNotify->mutex );
+        ++xTaskToNotify->notifyValue;
+    }
+    xTaskToNotify->notified.notify_one();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake( BaseType_t xClearCountOnExit, TickType_t xTicksToWait ) {
+    auto tcb = currentTask();
+    std::unique_lock<std::mutex> lock( tcb->mutex );
+    waitFor( tcb->notified, lock, xTicksToWait, [tcb] { return tcb->notifyValue != 0; } );
+    const uint32_t value = tcb->notifyValue;
+    if( value ) {
+        tcb->notifyValue = xClearCountOnExit ? 0 : value - 1;
+    }
+    return value;
+}